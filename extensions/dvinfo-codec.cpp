@@ -0,0 +1,248 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dvinfo-codec.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+namespace ndn {
+namespace ndvr {
+
+namespace {
+
+typedef std::vector<const std::string*> Dictionary;
+
+bool
+lessName(const std::string* a, const std::string* b)
+{
+  return *a < *b;
+}
+
+bool
+equalName(const std::string* a, const std::string* b)
+{
+  return *a == *b;
+}
+
+uint32_t
+indexOf(const Dictionary& dict, const std::string& name)
+{
+  return std::lower_bound(dict.begin(), dict.end(), &name, lessName) - dict.begin();
+}
+
+/* reads a dictionary index, which must be within the dictionary */
+bool
+readIndex(google::protobuf::io::CodedInputStream& in, const std::vector<std::string>& names,
+          const std::string*& name)
+{
+  uint32_t i;
+  if (!in.ReadVarint32(&i) || i >= names.size())
+    return false;
+  name = &names[i];
+  return true;
+}
+
+/* counts read from the wire are bounded by the remaining bytes (every item
+ * takes at least one byte), so a malformed DvInfo can not make us allocate */
+bool
+readCount(google::protobuf::io::CodedInputStream& in, size_t size, uint32_t& count)
+{
+  return in.ReadVarint32(&count) && count <= size - in.CurrentPosition();
+}
+
+/* Entry::Clear() frees the next_hops submessage, and the path strings with
+ * it. Clearing field by field keeps them, so the next entry decoded into
+ * the same message reuses their buffers */
+void
+clearEntry(proto::DvInfo_Entry& entry)
+{
+  entry.clear_prefix();
+  entry.clear_seq();
+  entry.clear_originator();
+  entry.mutable_next_hops()->Clear();
+}
+
+} // namespace
+
+void
+DvInfoCodec::Compress(const proto::DvInfo& dvinfo, std::string& out)
+{
+  Dictionary dict;
+  for (const auto& entry : dvinfo.entry()) {
+    dict.push_back(&entry.prefix());
+    dict.push_back(&entry.originator());
+    for (const auto& router : entry.next_hops().router_id())
+      dict.push_back(&router);
+  }
+  for (const auto& prefix : dvinfo.withdrawn())
+    dict.push_back(&prefix);
+  std::sort(dict.begin(), dict.end(), lessName);
+  dict.erase(std::unique(dict.begin(), dict.end(), equalName), dict.end());
+
+  out.push_back(static_cast<char>(kCompactMarker));
+  google::protobuf::io::StringOutputStream stream(&out);
+  google::protobuf::io::CodedOutputStream coded(&stream);
+  coded.WriteVarint32(dvinfo.version());
+  coded.WriteVarint32(dvinfo.is_delta());
+
+  coded.WriteVarint32(dict.size());
+  const std::string empty;
+  const std::string* prev = &empty;
+  for (const auto* name : dict) {
+    size_t shared = std::mismatch(prev->begin(), prev->begin() + std::min(prev->size(), name->size()),
+                                  name->begin()).first - prev->begin();
+    coded.WriteVarint32(shared);
+    coded.WriteVarint32(name->size() - shared);
+    coded.WriteRaw(name->data() + shared, name->size() - shared);
+    prev = name;
+  }
+
+  coded.WriteVarint32(dvinfo.entry_size());
+  for (const auto& entry : dvinfo.entry()) {
+    coded.WriteVarint32(indexOf(dict, entry.prefix()));
+    coded.WriteVarint64(entry.seq());
+    coded.WriteVarint32(indexOf(dict, entry.originator()));
+    coded.WriteVarint32(entry.next_hops().router_id_size());
+    for (const auto& router : entry.next_hops().router_id())
+      coded.WriteVarint32(indexOf(dict, router));
+    coded.WriteLittleEndian64(entry.next_hops().signature());
+  }
+
+  coded.WriteVarint32(dvinfo.withdrawn_size());
+  for (const auto& prefix : dvinfo.withdrawn())
+    coded.WriteVarint32(indexOf(dict, prefix));
+}
+
+bool
+DvInfoCodec::Decompress(const uint8_t* buf, size_t size, proto::DvInfo& dvinfo)
+{
+  dvinfo.Clear();
+  uint32_t version;
+  bool isDelta;
+  bool ok = readCompact(buf, size,
+      [&dvinfo] (const proto::DvInfo_Entry& entry) { *dvinfo.add_entry() = entry; },
+      [&dvinfo] (const std::string& prefix) { dvinfo.add_withdrawn(prefix); },
+      version, isDelta);
+  dvinfo.set_version(version);
+  dvinfo.set_is_delta(isDelta);
+  return ok;
+}
+
+/* Entries are decoded straight from the dictionary into the same
+ * proto::DvInfo_Entry, as Read does for the protobuf encoding */
+bool
+DvInfoCodec::readCompact(const uint8_t* buf, size_t size, const EntryCallback& onEntry,
+                         const WithdrawnCallback& onWithdrawn, uint32_t& version, bool& isDelta)
+{
+  version = 0;
+  isDelta = false;
+  if (!IsCompressed(buf, size))
+    return false;
+  google::protobuf::io::CodedInputStream in(buf + 1, size - 1);
+  size--;
+
+  uint32_t delta, count;
+  if (!in.ReadVarint32(&version) || !in.ReadVarint32(&delta))
+    return false;
+  isDelta = delta != 0;
+
+  if (!readCount(in, size, count))
+    return false;
+  std::vector<std::string> names(count);
+  std::string suffix;
+  for (uint32_t i = 0; i < names.size(); i++) {
+    uint32_t shared, length;
+    if (!in.ReadVarint32(&shared) || !in.ReadVarint32(&length) ||
+        (i == 0 ? shared > 0 : shared > names[i-1].size()) || !in.ReadString(&suffix, length))
+      return false;
+    if (i > 0)
+      names[i].assign(names[i-1], 0, shared);
+    names[i].append(suffix);
+  }
+
+  if (!readCount(in, size, count))
+    return false;
+  proto::DvInfo_Entry entry;
+  proto::DvInfo_NextHop* next_hops = entry.mutable_next_hops();
+  for (uint32_t i = 0; i < count; i++) {
+    clearEntry(entry);
+    const std::string* name;
+    uint64_t seq, signature;
+    uint32_t nRouters;
+    if (!readIndex(in, names, name))
+      return false;
+    entry.set_prefix(*name);
+    if (!in.ReadVarint64(&seq))
+      return false;
+    entry.set_seq(seq);
+    if (!readIndex(in, names, name))
+      return false;
+    entry.set_originator(*name);
+    if (!readCount(in, size, nRouters))
+      return false;
+    for (uint32_t j = 0; j < nRouters; j++) {
+      if (!readIndex(in, names, name))
+        return false;
+      next_hops->add_router_id(*name);
+    }
+    if (!in.ReadLittleEndian64(&signature))
+      return false;
+    next_hops->set_signature(signature);
+    onEntry(entry);
+  }
+
+  if (!readCount(in, size, count))
+    return false;
+  for (uint32_t i = 0; i < count; i++) {
+    const std::string* name;
+    if (!readIndex(in, names, name))
+      return false;
+    onWithdrawn(*name);
+  }
+  return static_cast<size_t>(in.CurrentPosition()) == size;
+}
+
+bool
+DvInfoCodec::Read(const uint8_t* buf, size_t size, const EntryCallback& onEntry,
+                  const WithdrawnCallback& onWithdrawn, uint32_t& version, bool& isDelta)
+{
+  if (IsCompressed(buf, size))
+    return readCompact(buf, size, onEntry, onWithdrawn, version, isDelta);
+
+  using google::protobuf::internal::WireFormatLite;
+  google::protobuf::io::CodedInputStream in(buf, size);
+  proto::DvInfo_Entry entry;
+  std::string withdrawn;
+  bool ok = true;
+  version = 0;
+  isDelta = false;
+
+  for (uint32_t tag = in.ReadTag(); tag != 0 && ok; tag = in.ReadTag()) {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    WireFormatLite::WireType type = WireFormatLite::GetTagWireType(tag);
+    if (field == proto::DvInfo::kEntryFieldNumber && type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      clearEntry(entry);
+      ok = WireFormatLite::ReadMessage(&in, &entry);
+      if (ok)
+        onEntry(entry);
+    } else if (field == proto::DvInfo::kWithdrawnFieldNumber && type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      ok = WireFormatLite::ReadString(&in, &withdrawn);
+      if (ok)
+        onWithdrawn(withdrawn);
+    } else if (field == proto::DvInfo::kIsDeltaFieldNumber && type == WireFormatLite::WIRETYPE_VARINT) {
+      ok = WireFormatLite::ReadPrimitive<bool, WireFormatLite::TYPE_BOOL>(&in, &isDelta);
+    } else if (field == proto::DvInfo::kVersionFieldNumber && type == WireFormatLite::WIRETYPE_VARINT) {
+      ok = WireFormatLite::ReadPrimitive<uint32_t, WireFormatLite::TYPE_UINT32>(&in, &version);
+    } else {
+      ok = WireFormatLite::SkipField(&in, tag);
+    }
+  }
+  return ok && in.ConsumedEntireMessage();
+}
+
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,77 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_DVINFO_CODEC_HPP
+#define NDVR_DVINFO_CODEC_HPP
+
+#include <functional>
+#include <string>
+
+#include "ndvr-message.pb.h"
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief compact encoding of DvInfo payloads
+ *
+ * DvInfo entries repeat long names: the prefixes, the originators and the
+ * routers on the path vectors, most of them under /<network>/%C1.Router.
+ * The compact encoding replaces every name by its index on a dictionary of
+ * the distinct names of the message, which is sorted and front coded (each
+ * name is the length it shares with the previous one plus the remaining
+ * suffix):
+ *
+ *   CompactDvInfo = %x00 version is-delta
+ *                   n-names *(shared-length suffix-length suffix)
+ *                   n-entries *(prefix seq originator n-routers *router signature)
+ *                   n-withdrawn *prefix
+ *
+ * Numbers are varints, names are dictionary indexes and the signature is a
+ * little-endian fixed64. A protobuf encoded DvInfo never starts with a zero
+ * byte (there is no field number 0), so the two encodings are told apart by
+ * the first byte.
+ */
+class DvInfoCodec
+{
+public:
+  static const uint8_t kCompactMarker = 0x00;
+
+  static void
+  Compress(const proto::DvInfo& dvinfo, std::string& out);
+
+  static bool
+  IsCompressed(const uint8_t* buf, size_t size)
+  {
+    return size > 0 && buf[0] == kCompactMarker;
+  }
+
+  /** @brief decodes a compact DvInfo, returns false if it is malformed */
+  static bool
+  Decompress(const uint8_t* buf, size_t size, proto::DvInfo& dvinfo);
+
+  typedef std::function<void(const proto::DvInfo_Entry&)> EntryCallback;
+  typedef std::function<void(const std::string&)> WithdrawnCallback;
+
+  /** @brief decodes a DvInfo (protobuf or compact) one item at a time
+   *
+   * Entries are decoded into the same proto::DvInfo_Entry, reusing its
+   * buffers, and handed to @p onEntry as they come; withdrawn prefixes go
+   * to @p onWithdrawn. Nothing is valid after the callback returns. The
+   * items before a decoding error have already been handed over when it
+   * returns false. The version is only known at the end, as protobuf
+   * encodes it after the entries.
+   */
+  static bool
+  Read(const uint8_t* buf, size_t size, const EntryCallback& onEntry,
+       const WithdrawnCallback& onWithdrawn, uint32_t& version, bool& isDelta);
+
+private:
+  static bool
+  readCompact(const uint8_t* buf, size_t size, const EntryCallback& onEntry,
+              const WithdrawnCallback& onWithdrawn, uint32_t& version, bool& isDelta);
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_DVINFO_CODEC_HPP
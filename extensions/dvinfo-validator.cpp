@@ -0,0 +1,283 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "dvinfo-validator.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <ndn-cxx/security/verification-helpers.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+namespace {
+
+const time::seconds kDigestLifetime = time::seconds(10);
+const size_t kMaxDigests = 1024;
+
+const Name kDvInfoPrefix("/localhop/ndvr/dvinfo");
+const name::Component kRouterComponent = name::Component::fromEscapedString("%C1.Router");
+const name::Component kKeyComponent("KEY");
+
+/* the rules of config/validation.conf the matchers below are equivalent
+ * to, without their ids and comments */
+const char kDefaultRules[] = R"CONF(
+rule
+{
+  for data
+  filter
+  {
+    type name
+    regex ^<localhop><ndvr><dvinfo><><%C1.Router><><><>?<>?<>?<>$
+  }
+  checker
+  {
+    type customized
+    sig-type ecdsa-sha256
+    key-locator
+    {
+      type name
+      hyper-relation
+      {
+        k-regex ^([^<KEY>]*)<KEY><>$
+        k-expand \\1
+        h-relation equal
+        p-regex ^<localhop><ndvr><dvinfo>(<><%C1.Router><>)<><>?<>?<>?<>$
+        p-expand \\1
+      }
+    }
+  }
+}
+rule
+{
+  for data
+  filter
+  {
+    type name
+    regex ^<><%C1.Router><><KEY><><><>$
+  }
+  checker
+  {
+    type customized
+    sig-type ecdsa-sha256
+    key-locator
+    {
+      type name
+      hyper-relation
+      {
+        k-regex ^([^<KEY>])<KEY><>$
+        k-expand \\1
+        h-relation equal
+        p-regex ^(<>)<%C1.Router><><KEY><><><>$
+        p-expand \\1
+      }
+    }
+  }
+}
+)CONF";
+
+/* the rules of a validation config, in order and without their ids (the
+ * trust anchors do not matter to the fast path) */
+std::vector<boost::property_tree::ptree>
+getRules(std::istream& input)
+{
+  boost::property_tree::ptree config;
+  boost::property_tree::read_info(input, config);
+  std::vector<boost::property_tree::ptree> rules;
+  for (const auto& section : config) {
+    if (section.first != "rule")
+      continue;
+    rules.push_back(section.second);
+    rules.back().erase("id");
+  }
+  return rules;
+}
+
+/* whether the config in @p filename has the rules of config/validation.conf */
+bool
+hasDefaultRules(const std::string& filename)
+{
+  try {
+    std::ifstream input(filename);
+    std::istringstream defaults(kDefaultRules);
+    return input && getRules(input) == getRules(defaults);
+  }
+  catch (const boost::property_tree::info_parser_error&) {
+    return false;
+  }
+}
+
+/* none of the first n components of name is KEY */
+bool
+hasNoKey(const Name& name, size_t n)
+{
+  return std::find(name.begin(), name.begin() + n, kKeyComponent) == name.begin() + n;
+}
+
+/* DvInfo rule of config/validation.conf:
+ *   regex ^<localhop><ndvr><dvinfo><><%C1.Router><><><>?<>?<>?<>$
+ *   k-regex ^([^<KEY>]*)<KEY><>$ equal to p-regex ^<localhop><ndvr><dvinfo>(<><%C1.Router><>)<><>?<>?<>?<>$
+ */
+bool
+matchDvInfoRule(const Name& name, const Name& keyName)
+{
+  return name.size() >= 8 && name.size() <= 11 && kDvInfoPrefix.isPrefixOf(name) &&
+         name.get(4) == kRouterComponent &&
+         keyName.size() == 5 && keyName.get(3) == kKeyComponent && hasNoKey(keyName, 3) &&
+         keyName.getPrefix(3) == name.getSubName(3, 3);
+}
+
+/* router certificate rule of config/validation.conf:
+ *   regex ^<><%C1.Router><><KEY><><><>$
+ *   k-regex ^([^<KEY>])<KEY><>$ equal to p-regex ^(<>)<%C1.Router><><KEY><><><>$
+ */
+bool
+matchRouterCertificateRule(const Name& name, const Name& keyName)
+{
+  return name.size() == 7 && name.get(1) == kRouterComponent && name.get(3) == kKeyComponent &&
+         keyName.size() == 3 && keyName.get(1) == kKeyComponent && hasNoKey(keyName, 1) &&
+         keyName.get(0) == name.get(0);
+}
+
+/* the key locator name of an ECDSA signature (the sig-type of both rules),
+ * or nullptr */
+const Name*
+getEcdsaKeyName(const Data& data)
+{
+  const SignatureInfo& info = data.getSignatureInfo();
+  if (info.getSignatureType() != tlv::SignatureSha256WithEcdsa || !info.hasKeyLocator() ||
+      info.getKeyLocator().getType() != tlv::Name)
+    return nullptr;
+  return &info.getKeyLocator().getName();
+}
+
+} // namespace
+
+DvInfoValidator::DvInfoValidator(Face& face)
+  : m_validator(face)
+{
+}
+
+void
+DvInfoValidator::load(const std::string& filename)
+{
+  m_validator.load(filename);
+  m_hasFastPath = hasDefaultRules(filename);
+  m_certificates.clear();
+  m_digests.clear();
+  m_digestOrder.clear();
+}
+
+void
+DvInfoValidator::validate(const Data& data, const SuccessCallback& onSuccess,
+                          const FailureCallback& onFailure)
+{
+  if (!m_hasFastPath)
+    return validateFully(data, onSuccess, onFailure);
+
+  name::Component digest = data.getFullName().get(-1);
+  auto it = m_digests.find(digest);
+  if (it != m_digests.end() && it->second > time::steady_clock::now()) {
+    m_nDigestHits++;
+    onSuccess(data);
+    return;
+  }
+
+  const security::v2::Certificate* cert = findCertificate(data);
+  if (cert != nullptr && m_workers != nullptr) {
+    /* the worker gets its own copies of the Data and the certificate */
+    auto copy = std::make_shared<Data>(data);
+    auto certCopy = std::make_shared<security::v2::Certificate>(*cert);
+    m_workers->submit(cert->getKeyName().toUri(),
+      [this, copy, certCopy, digest, onSuccess, onFailure] () -> WorkerPool::Completion {
+        bool verified = security::verifySignature(*copy, *certCopy);
+        return [this, copy, verified, digest, onSuccess, onFailure] {
+          if (!verified)
+            return validateFully(*copy, onSuccess, onFailure);
+          m_nCertificateHits++;
+          insertDigest(digest);
+          onSuccess(*copy);
+        };
+      });
+    return;
+  }
+  if (cert != nullptr && security::verifySignature(data, *cert)) {
+    m_nCertificateHits++;
+    insertDigest(digest);
+    onSuccess(data);
+    return;
+  }
+
+  validateFully(data, onSuccess, onFailure);
+}
+
+void
+DvInfoValidator::validateFully(const Data& data, const SuccessCallback& onSuccess,
+                               const FailureCallback& onFailure)
+{
+  m_nFullValidations++;
+  m_validator.validate(data,
+    [this, onSuccess] (const Data& data) {
+      insertDigest(data.getFullName().get(-1));
+      cacheCertificate(data);
+      onSuccess(data);
+    },
+    onFailure);
+}
+
+const security::v2::Certificate*
+DvInfoValidator::findCertificate(const Data& data)
+{
+  const Name* keyName = getEcdsaKeyName(data);
+  if (keyName == nullptr || !matchDvInfoRule(data.getName(), *keyName))
+    return nullptr;
+  auto it = m_certificates.find(*keyName);
+  if (it == m_certificates.end())
+    return nullptr;
+  if (!it->second.isValid()) {
+    m_certificates.erase(it);
+    return nullptr;
+  }
+  return &it->second;
+}
+
+void
+DvInfoValidator::cacheCertificate(const Data& data)
+{
+  const Name* keyName = getEcdsaKeyName(data);
+  if (keyName == nullptr || !matchDvInfoRule(data.getName(), *keyName) ||
+      m_certificates.count(*keyName) > 0)
+    return;
+
+  /* ValidatorConfig keeps the certificates of the chains it has verified */
+  Interest interest(*keyName);
+  interest.setCanBePrefix(true);
+  const security::v2::Certificate* cert = m_validator.findTrustedCert(interest);
+  if (cert == nullptr || cert->getKeyName() != *keyName || !cert->isValid())
+    return;
+  const Name* issuer = getEcdsaKeyName(*cert);
+  if (issuer == nullptr || !matchRouterCertificateRule(cert->getName(), *issuer))
+    return;
+  m_certificates.emplace(*keyName, *cert);
+}
+
+void
+DvInfoValidator::insertDigest(const name::Component& digest)
+{
+  auto now = time::steady_clock::now();
+  while (!m_digestOrder.empty() &&
+         (m_digestOrder.size() >= kMaxDigests || m_digests[m_digestOrder.front()] <= now)) {
+    m_digests.erase(m_digestOrder.front());
+    m_digestOrder.pop_front();
+  }
+  if (m_digests.emplace(digest, now + kDigestLifetime).second)
+    m_digestOrder.push_back(digest);
+}
+
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,125 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_DVINFO_VALIDATOR_HPP
+#define NDVR_DVINFO_VALIDATOR_HPP
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/security/validator-config.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+#include "worker-pool.hpp"
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief ValidatorConfig with a fast path for the DvInfo trust rules
+ *
+ * DvInfo segments, pushes and Merkle replies are all validated, and
+ * ValidatorConfig matches the rule regexes, looks the certificate chain up
+ * and verifies the signature every time. The fast path, only taken if the
+ * loaded rules are those of config/validation.conf (ids and trust anchors
+ * aside), since it hardcodes them:
+ *  - Data byte-identical to a Data validated less than kDigestLifetime ago
+ *    (same implicit digest: e.g., a pushed DvInfo that is pulled too, or a
+ *    retransmission answered twice) is accepted right away;
+ *  - Data matching the DvInfo rule, signed by a router key whose
+ *    certificate was validated before, is only verified against that
+ *    certificate. The rule is checked by component matchers equivalent to
+ *    its regexes. Router certificates are kept (if they match the router
+ *    certificate rule) for their validity period.
+ * Anything else, and everything with other rules, goes through
+ * ValidatorConfig, which also reports failures.
+ *
+ * With a WorkerPool, the signature verification of the second case runs on
+ * a worker thread. ValidatorConfig itself (which may fetch certificates
+ * through the Face) always runs on the main thread.
+ */
+class DvInfoValidator
+{
+public:
+  typedef std::function<void(const Data&)> SuccessCallback;
+  typedef std::function<void(const Data&, const security::v2::ValidationError&)> FailureCallback;
+
+  explicit
+  DvInfoValidator(Face& face);
+
+  /** @brief load the validation rules (see ValidatorConfig::load) */
+  void
+  load(const std::string& filename);
+
+  void
+  validate(const Data& data, const SuccessCallback& onSuccess, const FailureCallback& onFailure);
+
+  /** @brief verify signatures on @p workers (nullptr: on the main thread) */
+  void
+  SetWorkerPool(WorkerPool* workers)
+  {
+    m_workers = workers;
+  }
+
+  /** @brief whether the loaded rules allow the fast path */
+  bool
+  HasFastPath() const
+  {
+    return m_hasFastPath;
+  }
+
+  uint64_t
+  GetDigestHits() const
+  {
+    return m_nDigestHits;
+  }
+
+  uint64_t
+  GetCertificateHits() const
+  {
+    return m_nCertificateHits;
+  }
+
+  uint64_t
+  GetFullValidations() const
+  {
+    return m_nFullValidations;
+  }
+
+private:
+  /** @brief the cached certificate @p data must be verified against, or
+   * nullptr if @p data does not match the DvInfo rule or there is none */
+  const security::v2::Certificate*
+  findCertificate(const Data& data);
+
+  /** @brief keep the certificate of the key that signed @p data, once
+   * ValidatorConfig validated it */
+  void
+  cacheCertificate(const Data& data);
+
+  void
+  validateFully(const Data& data, const SuccessCallback& onSuccess, const FailureCallback& onFailure);
+
+  void
+  insertDigest(const name::Component& digest);
+
+private:
+  ValidatorConfig m_validator;
+  WorkerPool* m_workers = nullptr;
+  bool m_hasFastPath = false;
+  std::map<Name, security::v2::Certificate> m_certificates;  /* router certificates by key name */
+  /* implicit digests of validated Data, with their expiration. Entries
+   * expire in insertion order, so m_digestOrder is also the expiration order */
+  std::map<name::Component, time::steady_clock::TimePoint> m_digests;
+  std::deque<name::Component> m_digestOrder;
+  uint64_t m_nDigestHits = 0;
+  uint64_t m_nCertificateHits = 0;
+  uint64_t m_nFullValidations = 0;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_DVINFO_VALIDATOR_HPP
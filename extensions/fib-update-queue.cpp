@@ -0,0 +1,546 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "fib-update-queue.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+
+const std::string now_str();
+
+namespace ndn {
+namespace ndvr {
+
+const ndn::nfd::RouteOrigin FibUpdateQueue::ROUTE_ORIGIN_NDVR = static_cast<ndn::nfd::RouteOrigin>(130);
+constexpr time::seconds FibUpdateQueue::kMaxRetryDelay;
+constexpr time::seconds FibUpdateQueue::kStateSaveDelay;
+
+FibUpdateQueue::FibUpdateQueue(ndn::Face& face, ndn::nfd::Controller& controller)
+  : m_controller(controller)
+  , m_scheduler(face.getIoService())
+{
+}
+
+void
+FibUpdateQueue::Register(const Name& name, uint64_t faceId, uint32_t cost, Priority priority,
+                         std::function<void()> onInstalled)
+{
+  m_desired[Key(name, faceId)] = cost;
+  enqueue(Key(name, faceId), Op{true, cost, priority, 0, time::steady_clock::now(), std::move(onInstalled), false});
+}
+
+void
+FibUpdateQueue::Unregister(const Name& name, uint64_t faceId, Priority priority)
+{
+  m_desired.erase(Key(name, faceId));
+  enqueue(Key(name, faceId), Op{false, 0, priority, 0, time::steady_clock::now(), nullptr, false});
+}
+
+void
+FibUpdateQueue::SetStateFile(const std::string& filename)
+{
+  m_stateFile = filename;
+  m_previousRun.clear();
+  /* one next hop per line: <faceId> <prefix> */
+  std::ifstream input(filename);
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    uint64_t faceId;
+    std::string prefix;
+    if (!(fields >> faceId >> prefix))
+      continue;
+    try {
+      m_previousRun.emplace(Name(prefix), faceId);
+    }
+    catch (const std::exception&) {
+    }
+  }
+  if (!m_previousRun.empty())
+    std::cerr << now_str() << "FIB state file=" << filename << " nextHops=" << m_previousRun.size() << " left by a previous run" << std::endl;
+}
+
+void
+FibUpdateQueue::scheduleSaveState()
+{
+  if (!m_directFib || m_stateFile.empty() || m_saveEvent)
+    return;
+  m_saveEvent = m_scheduler.schedule(kStateSaveDelay, [this] { saveState(); });
+}
+
+void
+FibUpdateQueue::saveState()
+{
+  /* written aside and renamed, so that a crash never leaves half a file */
+  std::string tmp = m_stateFile + ".tmp";
+  {
+    std::ofstream output(tmp, std::ios::trunc);
+    for (const auto& route : m_installed)
+      output << route.first.second << " " << route.first.first << "\n";
+    if (!output) {
+      std::cerr << now_str() << "Fail to write FIB state file=" << tmp << std::endl;
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), m_stateFile.c_str()) != 0)
+    std::cerr << now_str() << "Fail to write FIB state file=" << m_stateFile << std::endl;
+}
+
+void
+FibUpdateQueue::ForgetFace(uint64_t faceId)
+{
+  m_softStateFaces.erase(faceId);
+  for (RouteMap* routes : {&m_installed, &m_desired}) {
+    for (auto it = routes->begin(); it != routes->end(); ) {
+      if (it->first.second == faceId)
+        it = routes->erase(it);
+      else
+        ++it;
+    }
+  }
+  scheduleSaveState();
+}
+
+void
+FibUpdateQueue::RefreshFace(uint64_t faceId, time::milliseconds expiration)
+{
+  auto now = time::steady_clock::now();
+  auto it = m_softStateFaces.find(faceId);
+  if (it == m_softStateFaces.end()) {
+    /* routes registered from now on will expire, nothing to refresh yet */
+    m_softStateFaces[faceId] = SoftStateFace{expiration, now};
+    return;
+  }
+  if (expiration <= it->second.expiration && now < it->second.refreshed + it->second.expiration / 2)
+    return;
+  it->second.expiration = expiration;
+  it->second.refreshed = now;
+
+  size_t nRefreshed = 0;
+  for (const auto& route : m_desired) {
+    if (route.first.second != faceId || expirationOf(route.first) == time::milliseconds::zero())
+      continue;
+    enqueue(route.first, Op{true, route.second, PRIORITY_NORMAL, 0, now, nullptr, true});
+    nRefreshed++;
+  }
+  if (nRefreshed > 0)
+    std::cerr << now_str() << "Refreshing routes faceId=" << faceId << " routes=" << nRefreshed << " expiration=" << expiration.count() << "ms" << std::endl;
+}
+
+void
+FibUpdateQueue::ExpireFace(uint64_t faceId)
+{
+  if (m_softStateFaces.count(faceId) == 0)
+    return;
+
+  /* the routes would age out inside NFD anyway, but only once their
+   * expiration period is over, and meanwhile NFD keeps forwarding to a
+   * dead next hop */
+  std::set<Key> expired;
+  for (RouteMap* routes : {&m_installed, &m_desired})
+    for (const auto& route : *routes)
+      if (route.first.second == faceId && expirationOf(route.first) != time::milliseconds::zero())
+        expired.insert(route.first);
+  for (const auto& key : expired)
+    Unregister(key.first, key.second);
+  m_softStateFaces.erase(faceId);
+  std::cerr << now_str() << "Expiring routes faceId=" << faceId << " routes=" << expired.size() << std::endl;
+}
+
+time::milliseconds
+FibUpdateQueue::expirationOf(const Key& key) const
+{
+  if (m_directFib)
+    return time::milliseconds::zero();
+  auto it = m_softStateFaces.find(key.second);
+  if (it == m_softStateFaces.end())
+    return time::milliseconds::zero();
+  for (const auto& prefix : m_permanentPrefixes)
+    if (prefix.isPrefixOf(key.first))
+      return time::milliseconds::zero();
+  return it->second.expiration;
+}
+
+void
+FibUpdateQueue::Adopt(const Name& name, uint64_t faceId, uint32_t cost)
+{
+  m_installed[Key(name, faceId)] = cost;
+}
+
+void
+FibUpdateQueue::UnregisterAll()
+{
+  std::set<Key> keys;
+  for (const auto& route : m_installed)
+    keys.insert(route.first);
+  for (const auto& route : m_desired)
+    keys.insert(route.first);
+  for (const auto& key : keys)
+    Unregister(key.first, key.second, PRIORITY_HIGH);
+}
+
+void
+FibUpdateQueue::enqueue(const Key& key, const Op& op)
+{
+  auto it = m_pending.find(key);
+  if (it == m_pending.end()) {
+    m_pending.emplace(key, op);
+    if (m_inFlight.count(key) == 0)
+      m_queue[op.priority].push_back(key);
+  }
+  else {
+    /* the latest update wins, but it keeps the highest priority */
+    m_nCoalesced++;
+    Priority priority = std::min(it->second.priority, op.priority);
+    if (priority != it->second.priority && m_inFlight.count(key) == 0)
+      m_queue[priority].push_back(key);
+    auto requested = it->second.requested;
+    /* whoever waits for the route to be installed keeps waiting, unless the
+     * route is not wanted anymore */
+    auto onInstalled = op.onInstalled;
+    if (op.add && it->second.add && it->second.onInstalled) {
+      auto previous = it->second.onInstalled;
+      auto next = op.onInstalled;
+      onInstalled = [previous, next] {
+        previous();
+        if (next)
+          next();
+      };
+    }
+    bool refresh = op.add && it->second.add && (op.refresh || it->second.refresh);
+    it->second = op;
+    it->second.priority = priority;
+    it->second.requested = requested;
+    it->second.onInstalled = onInstalled;
+    it->second.refresh = refresh;
+  }
+
+  if (op.priority == PRIORITY_HIGH)
+    scheduleFlush(time::milliseconds(0));
+  else
+    scheduleFlush(m_window);
+}
+
+void
+FibUpdateQueue::scheduleFlush(time::milliseconds after)
+{
+  auto when = time::steady_clock::now() + after;
+  if (m_flushEvent && m_flushTime <= when)
+    return;
+  m_flushEvent.cancel();
+  m_flushTime = when;
+  m_flushEvent = m_scheduler.schedule(after, [this] { flush(); });
+}
+
+void
+FibUpdateQueue::flush()
+{
+  for (int q = PRIORITY_HIGH; q <= PRIORITY_NORMAL; ++q) {
+    while (!m_queue[q].empty() && m_inFlight.size() < m_maxInFlight) {
+      Key key = m_queue[q].front();
+      m_queue[q].pop_front();
+
+      auto it = m_pending.find(key);
+      if (it == m_pending.end() || it->second.priority != q || m_inFlight.count(key) > 0)
+        continue;
+      Op op = it->second;
+      m_pending.erase(it);
+
+      /* nothing to do if NFD already has what we want */
+      auto installed = m_installed.find(key);
+      if (!op.refresh && (op.add ? (installed != m_installed.end() && installed->second == op.cost)
+                                 : (installed == m_installed.end()))) {
+        m_nSkipped++;
+        if (op.onInstalled)
+          op.onInstalled();
+        continue;
+      }
+      dispatch(key, op);
+    }
+  }
+}
+
+void
+FibUpdateQueue::dispatch(const Key& key, const Op& op)
+{
+  ::ndn::nfd::ControlParameters controlParameters;
+  controlParameters
+    .setName(key.first)
+    .setFaceId(key.second);
+  if (op.add)
+    controlParameters.setCost(op.cost);
+  if (!m_directFib)
+    controlParameters.setOrigin(ROUTE_ORIGIN_NDVR);
+  auto expiration = expirationOf(key);
+  if (op.add && expiration > time::milliseconds::zero())
+    controlParameters.setExpirationPeriod(expiration);
+  ::ndn::nfd::CommandOptions options;
+  options.setTimeout(time::duration_cast<time::milliseconds>(time::seconds(1)));
+
+  auto onSuccessCb = [this, key, op] (const ::ndn::nfd::ControlParameters&) { onSuccess(key, op); };
+  auto onFailureCb = [this, key, op] (const ::ndn::nfd::ControlResponse& resp) { onFailure(key, op, resp); };
+
+  m_inFlight[key] = time::steady_clock::now();
+  m_nSent++;
+  try {
+    if (m_directFib && op.add)
+      m_controller.start<::ndn::nfd::FibAddNextHopCommand>(controlParameters, onSuccessCb, onFailureCb, options);
+    else if (m_directFib)
+      m_controller.start<::ndn::nfd::FibRemoveNextHopCommand>(controlParameters, onSuccessCb, onFailureCb, options);
+    else if (op.add)
+      m_controller.start<::ndn::nfd::RibRegisterCommand>(controlParameters, onSuccessCb, onFailureCb, options);
+    else
+      m_controller.start<::ndn::nfd::RibUnregisterCommand>(controlParameters, onSuccessCb, onFailureCb, options);
+  }
+  catch (const std::exception& e) {
+    std::cerr << now_str() << "FIB update exception (name=" << key.first << " faceId=" << key.second << "): " << e.what() << std::endl;
+    m_inFlight.erase(key);
+  }
+}
+
+void
+FibUpdateQueue::onDone(const Key& key)
+{
+  m_inFlight.erase(key);
+  /* updates that arrived meanwhile were held back, send them now */
+  auto it = m_pending.find(key);
+  if (it != m_pending.end())
+    m_queue[it->second.priority].push_front(key);
+  flush();
+}
+
+void
+FibUpdateQueue::onSuccess(const Key& key, const Op& op)
+{
+  auto now = time::steady_clock::now();
+  auto rtt = now - m_inFlight[key];
+  std::cerr << now_str() << (op.add ? "register" : "unregister") << (m_directFib ? " fib" : " rib") << " success name=" << key.first << " faceId=" << key.second << " latency=" << time::duration_cast<time::microseconds>(now - op.requested).count() << "us rtt=" << time::duration_cast<time::microseconds>(rtt).count() << "us inFlight=" << m_inFlight.size() << " pending=" << m_pending.size() << std::endl;
+  if (op.add) {
+    m_installed[key] = op.cost;
+    /* refreshes do not count as installs */
+    if (!op.refresh) {
+      m_nInstalled++;
+      m_latencySum += now - op.requested;
+      m_latencyMax = std::max(m_latencyMax, time::duration_cast<time::nanoseconds>(now - op.requested));
+    }
+    if (!op.refresh && m_nInstalled % kLatencyReportInterval == 0)
+      std::cerr << now_str() << "Route install latency (" << (m_directFib ? "fib" : "rib") << "): installed=" << m_nInstalled << " avg=" << time::duration_cast<time::microseconds>(m_latencySum / m_nInstalled).count() << "us max=" << time::duration_cast<time::microseconds>(m_latencyMax).count() << "us sent=" << m_nSent << " coalesced=" << m_nCoalesced << " skipped=" << m_nSkipped << " failed=" << m_nFailed << std::endl;
+    if (op.onInstalled)
+      op.onInstalled();
+  }
+  else
+    m_installed.erase(key);
+  scheduleSaveState();
+  onDone(key);
+}
+
+void
+FibUpdateQueue::onFailure(const Key& key, const Op& op, const ndn::nfd::ControlResponse& resp)
+{
+  m_nFailed++;
+  std::cerr << now_str() << "Fail to " << (op.add ? "register" : "unregister") << (m_directFib ? " fib" : " rib") << " entry (name=" << key.first << " faceId=" << key.second << " retry=" << static_cast<int>(op.retry) << "): code=" << resp.getCode() << " error=" << resp.getText() << " sent=" << m_nSent << " failed=" << m_nFailed << " coalesced=" << m_nCoalesced << " skipped=" << m_nSkipped << std::endl;
+  /* a newer update for this route superseded it: whoever waits for the
+   * route to be installed waits for that one, if it still adds the route */
+  auto pending = m_pending.find(key);
+  if (pending != m_pending.end()) {
+    if (op.add && op.onInstalled && pending->second.add) {
+      auto previous = op.onInstalled;
+      auto next = pending->second.onInstalled;
+      pending->second.onInstalled = [previous, next] {
+        previous();
+        if (next)
+          next();
+      };
+    }
+    onDone(key);
+    return;
+  }
+  if (op.retry < kMaxRetries) {
+    Op retry = op;
+    retry.retry++;
+    /* the first attempt already counts as the request time */
+    m_pending.emplace(key, retry);
+    m_queue[retry.priority].push_back(key);
+    m_inFlight.erase(key);
+    scheduleFlush(m_window);
+    return;
+  }
+  /* someone waits for this route to be installed (e.g., to start sending
+   * hellos on the face): keep trying, less and less often, for as long as
+   * the route is wanted, instead of leaving them waiting forever */
+  if (op.add && op.onInstalled) {
+    Op retry = op;
+    if (retry.retry < std::numeric_limits<uint8_t>::max())
+      retry.retry++;
+    int exponent = std::min(std::max(0, int(op.retry) - int(kMaxRetries)), 5);
+    auto delay = std::min(kMaxRetryDelay, time::seconds(1 << exponent));
+    std::cerr << now_str() << "Route still wanted, retrying in " << delay.count() << "s name=" << key.first << " faceId=" << key.second << std::endl;
+    m_scheduler.schedule(delay, [this, key, retry] () mutable {
+      auto desired = m_desired.find(key);
+      if (desired == m_desired.end())
+        return;
+      retry.cost = desired->second;
+      enqueue(key, retry);
+    });
+  }
+  onDone(key);
+}
+
+void
+FibUpdateQueue::StartReconciler(time::seconds interval, time::seconds adoptionGrace)
+{
+  m_reconcileInterval = interval;
+  m_adoptUntil = time::steady_clock::now() + adoptionGrace;
+  Reconcile();
+}
+
+void
+FibUpdateQueue::Reconcile()
+{
+  m_reconcileEvent.cancel();
+  if (m_reconciling)
+    return;
+  m_reconciling = true;
+  auto started = time::steady_clock::now();
+  fetchActual([this, started] (RouteMap& actual) { onActual(actual, started); });
+}
+
+bool
+FibUpdateQueue::isManaged(const Name& name) const
+{
+  static const Name localhost("/localhost");
+  static const Name localhop("/localhop");
+  return !m_directFib || !(localhost.isPrefixOf(name) || localhop.isPrefixOf(name));
+}
+
+void
+FibUpdateQueue::fetchActual(std::function<void(RouteMap&)> cb)
+{
+  auto onError = [this] (uint32_t code, const std::string& reason) {
+    std::cerr << now_str() << "Reconcile: fail to fetch dataset: code=" << code << " error=" << reason << std::endl;
+    m_reconciling = false;
+    if (m_reconcileInterval > time::seconds(0))
+      m_reconcileEvent = m_scheduler.schedule(m_reconcileInterval, [this] { Reconcile(); });
+  };
+
+  if (m_directFib) {
+    /* The FIB does not tell who added a next hop, and other applications
+     * may add next hops straight on the FIB too. Only the (prefix, face)
+     * pairs we installed, or want, are ours to reconcile; anything else is
+     * left alone. Next hops left by a previous run are known from the state
+     * file, and adopted like the RIB routes of a previous run */
+    m_controller.fetch<ndn::nfd::FibDataset>(
+      [this, cb] (const std::vector<ndn::nfd::FibEntry>& fib) {
+        RouteMap actual;
+        for (const auto& entry : fib) {
+          const Name& prefix = entry.getPrefix();
+          if (!isManaged(prefix))
+            continue;
+          for (const auto& nh : entry.getNextHopRecords()) {
+            Key key(prefix, nh.getFaceId());
+            if (m_installed.count(key) > 0 || m_desired.count(key) > 0 || isInTransition(key) ||
+                m_previousRun.count(key) > 0)
+              actual[key] = nh.getCost();
+          }
+        }
+        cb(actual);
+      },
+      onError);
+    return;
+  }
+
+  m_controller.fetch<ndn::nfd::RibDataset>(
+    [this, cb] (const std::vector<ndn::nfd::RibEntry>& rib) {
+      RouteMap actual;
+      for (const auto& entry : rib)
+        for (const auto& route : entry.getRoutes())
+          if (route.getOrigin() == ROUTE_ORIGIN_NDVR) {
+            Key key(entry.getName(), route.getFaceId());
+            /* unwanted routes that expire (e.g., left by a crashed run)
+             * are not worth a command, NFD removes them soon */
+            if (route.hasExpirationPeriod() && m_desired.count(key) == 0)
+              continue;
+            actual[key] = route.getCost();
+          }
+      cb(actual);
+    },
+    onError);
+}
+
+void
+FibUpdateQueue::onActual(RouteMap& actual, time::steady_clock::TimePoint started)
+{
+  auto fetched = time::steady_clock::now();
+  bool adopting = fetched < m_adoptUntil;
+  size_t nAdded = 0, nRemoved = 0, nUpdated = 0, nTransition = 0, nAdopted = 0;
+
+  /* what NFD has is the new truth, except for routes being changed */
+  for (auto it = m_installed.begin(); it != m_installed.end(); ) {
+    if (actual.count(it->first) == 0 && !isInTransition(it->first))
+      it = m_installed.erase(it);
+    else
+      ++it;
+  }
+
+  for (const auto& route : actual) {
+    if (isInTransition(route.first)) {
+      nTransition++;
+      continue;
+    }
+    m_installed[route.first] = route.second;
+    if (m_desired.count(route.first) > 0)
+      continue;
+    /* not wanted (anymore), unless we are still adopting routes from a
+     * previous run */
+    if (adopting) {
+      nAdopted++;
+      continue;
+    }
+    enqueue(route.first, Op{false, 0, PRIORITY_NORMAL, 0, fetched, nullptr, false});
+    nRemoved++;
+  }
+
+  for (const auto& route : m_desired) {
+    if (!isManaged(route.first.first))
+      continue;
+    if (isInTransition(route.first)) {
+      nTransition++;
+      continue;
+    }
+    auto it = actual.find(route.first);
+    if (it != actual.end() && it->second == route.second)
+      continue;
+    if (it == actual.end())
+      nAdded++;
+    else
+      nUpdated++;
+    enqueue(route.first, Op{true, route.second, PRIORITY_NORMAL, 0, fetched, nullptr, false});
+  }
+
+  /* those still on the FIB are adopted (installed) now */
+  m_previousRun.clear();
+  scheduleSaveState();
+
+  auto done = time::steady_clock::now();
+  std::cerr << now_str() << "Reconcile pass (" << (m_directFib ? "fib" : "rib") << "): actual=" << actual.size()
+            << " desired=" << m_desired.size() << " added=" << nAdded << " removed=" << nRemoved
+            << " updated=" << nUpdated << " inTransition=" << nTransition << " adopted=" << nAdopted
+            << " fetch=" << time::duration_cast<time::milliseconds>(fetched - started).count() << "ms"
+            << " diff=" << time::duration_cast<time::milliseconds>(done - fetched).count() << "ms" << std::endl;
+
+  m_reconciling = false;
+  if (m_reconcileInterval > time::seconds(0)) {
+    /* make sure the adoption grace period ends with a pass */
+    auto next = m_reconcileInterval;
+    if (adopting && m_adoptUntil - done < next)
+      next = time::duration_cast<time::seconds>(m_adoptUntil - done) + time::seconds(1);
+    m_reconcileEvent = m_scheduler.schedule(next, [this] { Reconcile(); });
+  }
+}
+
+} // namespace ndvr
+} // namespace ndn
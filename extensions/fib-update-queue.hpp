@@ -0,0 +1,299 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_FIB_UPDATE_QUEUE_HPP
+#define NDVR_FIB_UPDATE_QUEUE_HPP
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/mgmt/nfd/controller.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief queue of route (un)registrations sent to NFD
+ *
+ * Every change in the routing table used to fire its own RIB command. Here
+ * they are queued per (name, faceId) and only the latest one is kept, so a
+ * register/unregister/register sequence within the coalescing window ends
+ * up as a single command, or none at all when it does not change what NFD
+ * already has (the queue remembers the routes it installed).
+ *
+ * At most maxInFlight commands are outstanding at any time and commands
+ * for the same (name, faceId) are never sent concurrently. High priority
+ * updates (neighbor, router and protocol prefixes) skip the coalescing
+ * window and go ahead of the bulk of routes. Failed commands are retried
+ * through the queue, unless a newer update for the same route shows up
+ * (whoever waited for the failed one then waits for it).
+ *
+ * Routes are registered on the NFD RIB by default. In direct FIB mode the
+ * next hops are added/removed straight on the FIB (fib/add-nexthop and
+ * fib/remove-nexthop), skipping the RIB processing for routes NDVR fully
+ * owns. The install latency (from the first update to NFD's reply) is
+ * logged for both modes.
+ *
+ * Besides the routes it installed, the queue keeps the desired state (the
+ * latest Register/Unregister of each route). A reconciler periodically
+ * fetches what NFD actually has (rib/list, or fib/list in direct FIB mode)
+ * and sends only the commands needed to fix the differences. Its first
+ * pass, at startup, adopts the routes left by a previous run: they are
+ * kept during a grace period, so that routes learned again are not
+ * churned, and removed afterwards if nobody wants them anymore. The FIB
+ * does not record who added a next hop, so in direct FIB mode only the
+ * next hops the queue installed (or wants) are reconciled. There, the
+ * next hops installed are recorded in a state file (see SetStateFile), and
+ * those a previous run recorded are adopted if still on the FIB.
+ *
+ * Routes on a face with an expiration (see RefreshFace) are soft state on
+ * the RIB: they are registered with an expiration period and refreshed in
+ * bulk while the face is kept alive. When it is not anymore (ExpireFace),
+ * they are unregistered like any other update; the expiration only bounds
+ * how long they outlive us if NDVR goes away without removing them. Routes
+ * under a permanent prefix (e.g., the protocol prefixes) never expire, nor
+ * do routes in direct FIB mode, which has no expiration.
+ */
+class FibUpdateQueue
+{
+public:
+  enum Priority {
+    PRIORITY_HIGH = 0,
+    PRIORITY_NORMAL = 1,
+  };
+
+  FibUpdateQueue(ndn::Face& face, ndn::nfd::Controller& controller);
+
+  /** @brief @p onInstalled (optional) is called once NFD has the route,
+   * i.e., after the command succeeded or right away if it was already there.
+   * It is dropped if the route is unregistered meanwhile. Routes someone
+   * waits for are retried (every kMaxRetryDelay at most) until installed */
+  void
+  Register(const Name& name, uint64_t faceId, uint32_t cost, Priority priority = PRIORITY_NORMAL,
+           std::function<void()> onInstalled = nullptr);
+
+  void
+  Unregister(const Name& name, uint64_t faceId, Priority priority = PRIORITY_NORMAL);
+
+  /** @brief forget the routes installed on a face destroyed by NFD (NFD
+   * removes them by itself) */
+  void
+  ForgetFace(uint64_t faceId);
+
+  /** @brief routes on @p faceId are registered with @p expiration. They are
+   * registered again (refreshed) when half of it has passed, or when the
+   * expiration grows, so this should be called as the face is seen alive */
+  void
+  RefreshFace(uint64_t faceId, time::milliseconds expiration);
+
+  /** @brief stop refreshing the routes on @p faceId and unregister them.
+   * Permanent routes are not affected */
+  void
+  ExpireFace(uint64_t faceId);
+
+  /** @brief routes under @p prefix are never registered with an expiration */
+  void
+  AddPermanentPrefix(const Name& prefix)
+  {
+    m_permanentPrefixes.push_back(prefix);
+  }
+
+  /** @brief take a route found on NFD as installed by us, so that it can be
+   * updated or removed through the queue */
+  void
+  Adopt(const Name& name, uint64_t faceId, uint32_t cost);
+
+  /** @brief unregister every route we have (or want) on NFD */
+  void
+  UnregisterAll();
+
+  /** @brief adopt the routes NFD already has, then reconcile them every
+   * @p interval. Unwanted routes are only removed after @p adoptionGrace */
+  void
+  StartReconciler(time::seconds interval, time::seconds adoptionGrace);
+
+  /** @brief run a reconcile pass now */
+  void
+  Reconcile();
+
+  /** @brief in direct FIB mode, record the next hops installed in
+   * @p filename (rewritten kStateSaveDelay after changes) and adopt those
+   * it lists from a previous run. Call before StartReconciler */
+  void
+  SetStateFile(const std::string& filename);
+
+  void
+  SetDirectFib(bool directFib)
+  {
+    m_directFib = directFib;
+  }
+
+  bool
+  IsDirectFib() const
+  {
+    return m_directFib;
+  }
+
+  void
+  SetCoalesceWindow(time::milliseconds window)
+  {
+    m_window = window;
+  }
+
+  void
+  SetMaxInFlight(size_t maxInFlight)
+  {
+    m_maxInFlight = maxInFlight;
+  }
+
+  size_t
+  GetPendingSize() const
+  {
+    return m_pending.size();
+  }
+
+  size_t
+  GetInFlight() const
+  {
+    return m_inFlight.size();
+  }
+
+  /** @brief origin of the routes NDVR registers on the RIB */
+  static const ndn::nfd::RouteOrigin ROUTE_ORIGIN_NDVR;
+
+private:
+  typedef std::pair<Name, uint64_t> Key;
+  typedef std::map<Key, uint32_t> RouteMap;
+
+  struct Op {
+    bool add;
+    uint32_t cost;
+    Priority priority;
+    uint8_t retry;
+    /* when the update was first requested (kept while coalescing) */
+    time::steady_clock::TimePoint requested;
+    std::function<void()> onInstalled;
+    /* send even if NFD already has the route, to extend its expiration */
+    bool refresh;
+  };
+
+  struct SoftStateFace {
+    time::milliseconds expiration;
+    time::steady_clock::TimePoint refreshed;
+  };
+
+  void
+  enqueue(const Key& key, const Op& op);
+
+  void
+  scheduleFlush(time::milliseconds after);
+
+  /*! \brief Send as many pending updates as the in-flight limit allows.
+   */
+  void
+  flush();
+
+  void
+  dispatch(const Key& key, const Op& op);
+
+  void
+  onDone(const Key& key);
+
+  void
+  onSuccess(const Key& key, const Op& op);
+
+  void
+  onFailure(const Key& key, const Op& op, const ndn::nfd::ControlResponse& resp);
+
+  /*! \brief Routes NDVR does not manage in direct FIB mode (they can not be
+   *  told apart from NFD's own next hops).
+   */
+  bool
+  isManaged(const Name& name) const;
+
+  /*! \brief Fetch the routes NFD has for us and hand them to @p cb.
+   */
+  void
+  fetchActual(std::function<void(RouteMap&)> cb);
+
+  void
+  onActual(RouteMap& actual, time::steady_clock::TimePoint started);
+
+  /*! \brief Write the installed next hops to the state file soon.
+   */
+  void
+  scheduleSaveState();
+
+  void
+  saveState();
+
+  /*! \brief Expiration period of a route (zero if it is permanent).
+   */
+  time::milliseconds
+  expirationOf(const Key& key) const;
+
+  bool
+  isInTransition(const Key& key) const
+  {
+    return m_pending.count(key) > 0 || m_inFlight.count(key) > 0;
+  }
+
+private:
+  ndn::nfd::Controller& m_controller;
+  ndn::Scheduler m_scheduler;
+  scheduler::EventId m_flushEvent;
+  time::steady_clock::TimePoint m_flushTime;
+  time::milliseconds m_window = time::milliseconds(20);
+  size_t m_maxInFlight = 16;
+  bool m_directFib = false;
+  static const uint8_t kMaxRetries = 3;
+  static constexpr time::seconds kMaxRetryDelay = time::seconds(30);
+  static constexpr time::seconds kStateSaveDelay = time::seconds(1);
+
+  /* latest update not yet sent, per route */
+  std::map<Key, Op> m_pending;
+  /* routes with a pending update, per priority. A route may show up more
+   * than once (e.g., after its priority was raised), stale slots are
+   * skipped when popped */
+  std::deque<Key> m_queue[2];
+  /* routes with a command in flight and when it was sent */
+  std::map<Key, time::steady_clock::TimePoint> m_inFlight;
+  /* routes NFD has (as far as we know) and their costs */
+  RouteMap m_installed;
+  /* routes we want NFD to have and their costs */
+  RouteMap m_desired;
+  /* faces whose routes are soft state */
+  std::map<uint64_t, SoftStateFace> m_softStateFaces;
+  std::vector<Name> m_permanentPrefixes;
+
+  /* direct FIB mode: where the installed next hops are recorded, and those
+   * recorded by a previous run, until the first reconcile pass */
+  std::string m_stateFile;
+  scheduler::EventId m_saveEvent;
+  std::set<Key> m_previousRun;
+
+  scheduler::EventId m_reconcileEvent;
+  time::seconds m_reconcileInterval = time::seconds(0);
+  time::steady_clock::TimePoint m_adoptUntil;
+  bool m_reconciling = false;
+
+  uint64_t m_nCoalesced = 0;
+  uint64_t m_nSkipped = 0;
+  uint64_t m_nSent = 0;
+  uint64_t m_nFailed = 0;
+  /* route install latency, from the update request to NFD's reply */
+  uint64_t m_nInstalled = 0;
+  time::nanoseconds m_latencySum = time::nanoseconds(0);
+  time::nanoseconds m_latencyMax = time::nanoseconds(0);
+  static const uint64_t kLatencyReportInterval = 100;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_FIB_UPDATE_QUEUE_HPP
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ndvr-hello.hpp"
+
+#include <cstring>
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/encoding/encoding-buffer.hpp>
+#include <ndn-cxx/encoding/tlv.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+namespace {
+
+/* reads the TLV at @p pos, advancing it past the TLV */
+bool
+readTlv(const uint8_t*& pos, const uint8_t* end, uint32_t& type, const uint8_t*& value, size_t& length)
+{
+  uint64_t len = 0;
+  if (!::ndn::tlv::readType(pos, end, type) || !::ndn::tlv::readVarNumber(pos, end, len) ||
+      len > static_cast<uint64_t>(end - pos))
+    return false;
+  value = pos;
+  length = static_cast<size_t>(len);
+  pos += length;
+  return true;
+}
+
+bool
+readNonNegativeInteger(const uint8_t* value, size_t length, uint64_t& number)
+{
+  if (length != 1 && length != 2 && length != 4 && length != 8)
+    return false;
+  number = 0;
+  for (size_t i = 0; i < length; ++i)
+    number = (number << 8) | value[i];
+  return true;
+}
+
+} // namespace
+
+Block
+HelloParams::Encode(uint64_t numPrefixes, const uint8_t* digest, size_t digestSize, uint64_t version,
+                    const std::vector<Name>& neighbors, const std::string& macAddress, uint64_t flags,
+                    time::milliseconds maxSilence)
+{
+  /* TLVs are prepended, so they go in reverse order */
+  EncodingBuffer encoder;
+  size_t length = 0;
+  if (!macAddress.empty())
+    length += prependBinaryBlock(encoder, TLV_MAC_ADDRESS,
+                                 make_span(reinterpret_cast<const uint8_t*>(macAddress.data()), macAddress.size()));
+  for (auto it = neighbors.rbegin(); it != neighbors.rend(); ++it) {
+    const Block& wire = it->wireEncode();
+    length += prependBinaryBlock(encoder, TLV_NEIGHBOR, make_span(wire.value(), wire.value_size()));
+  }
+  if (maxSilence > time::milliseconds::zero())
+    length += prependNonNegativeIntegerBlock(encoder, TLV_MAX_SILENCE, maxSilence.count());
+  if (flags != 0)
+    length += prependNonNegativeIntegerBlock(encoder, TLV_FLAGS, flags);
+  length += prependNonNegativeIntegerBlock(encoder, TLV_VERSION, version);
+  if (digestSize > 0)
+    length += prependBinaryBlock(encoder, TLV_DIGEST, make_span(digest, digestSize));
+  length += prependNonNegativeIntegerBlock(encoder, TLV_NUM_PREFIXES, numPrefixes);
+  length += encoder.prependVarNumber(length);
+  encoder.prependVarNumber(::ndn::tlv::ApplicationParameters);
+  return encoder.block();
+}
+
+bool
+HelloParams::Decode(const uint8_t* buf, size_t size)
+{
+  *this = HelloParams();
+  m_begin = buf;
+  m_end = buf + size;
+
+  bool hasNumPrefixes = false, hasVersion = false;
+  const uint8_t* pos = m_begin;
+  while (pos < m_end) {
+    uint32_t type;
+    const uint8_t* value;
+    size_t length;
+    if (!readTlv(pos, m_end, type, value, length))
+      return false;
+    switch (type) {
+      case TLV_NUM_PREFIXES:
+        if (!readNonNegativeInteger(value, length, m_numPrefixes))
+          return false;
+        hasNumPrefixes = true;
+        break;
+      case TLV_DIGEST:
+        m_digest = value;
+        m_digestSize = length;
+        break;
+      case TLV_VERSION:
+        if (!readNonNegativeInteger(value, length, m_version))
+          return false;
+        hasVersion = true;
+        break;
+      case TLV_FLAGS:
+        if (!readNonNegativeInteger(value, length, m_flags))
+          return false;
+        break;
+      case TLV_MAX_SILENCE:
+        if (!readNonNegativeInteger(value, length, m_maxSilence))
+          return false;
+        break;
+      case TLV_MAC_ADDRESS:
+        m_mac = value;
+        m_macSize = length;
+        break;
+      default:
+        /* neighbors are only looked at on demand (HasNeighbor), anything
+         * else is unknown and skipped */
+        break;
+    }
+  }
+  return hasNumPrefixes && hasVersion;
+}
+
+bool
+HelloParams::IsDigest(const uint8_t* digest, size_t size) const
+{
+  return size == m_digestSize && (size == 0 || std::memcmp(digest, m_digest, size) == 0);
+}
+
+bool
+HelloParams::HasNeighbor(const Name& routerPrefix) const
+{
+  const Block& wire = routerPrefix.wireEncode();
+  const uint8_t* pos = m_begin;
+  while (pos < m_end) {
+    uint32_t type;
+    const uint8_t* value;
+    size_t length;
+    if (!readTlv(pos, m_end, type, value, length))
+      return false;
+    if (type == TLV_NEIGHBOR && length == wire.value_size() &&
+        std::memcmp(value, wire.value(), length) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_HELLO_HPP
+#define NDVR_HELLO_HPP
+
+#include <string>
+#include <vector>
+
+#include <ndn-cxx/encoding/block.hpp>
+#include <ndn-cxx/name.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief parameters of a hello (dvannc) Interest
+ *
+ * Hellos are the most frequent NDVR packet, so their parameters are carried
+ * as compact TLVs (TLV-TYPEs from the application range) on the Interest
+ * ApplicationParameters, instead of name components and strings:
+ *
+ *   HelloParameters = NUM-PREFIXES-TYPE TLV-LENGTH NonNegativeInteger
+ *                     [DIGEST-TYPE TLV-LENGTH 20OCTET]
+ *                     VERSION-TYPE TLV-LENGTH NonNegativeInteger
+ *                     [FLAGS-TYPE TLV-LENGTH NonNegativeInteger]
+ *                     [MAX-SILENCE-TYPE TLV-LENGTH NonNegativeInteger]
+ *                     *(NEIGHBOR-TYPE TLV-LENGTH *NameComponent)
+ *                     [MAC-ADDRESS-TYPE TLV-LENGTH *OCTET]
+ *
+ * The digest is omitted while the routing table is empty. Flags tell the
+ * optional features the sender supports (omitted if none). The max silence
+ * is the longest time, in milliseconds, the sender may go without a hello
+ * (see TrickleTimer::GetMaxSilence), so neighbors can time it out even if
+ * it uses another hello interval than theirs. Neighbors are the
+ * routers the sender is about to ask a DvInfo from. Unknown TLVs are skipped.
+ *
+ * Decoding does not allocate: the digest, neighbors and MAC address point to
+ * the Interest buffer, which must outlive the HelloParams.
+ */
+class HelloParams
+{
+public:
+  enum {
+    TLV_NUM_PREFIXES = 200,
+    TLV_DIGEST = 201,
+    TLV_VERSION = 202,
+    TLV_NEIGHBOR = 203,
+    TLV_MAC_ADDRESS = 204,
+    TLV_FLAGS = 205,
+    TLV_MAX_SILENCE = 206,
+  };
+
+  enum {
+    /* the sender accepts compact DvInfo (see DvInfoCodec) */
+    FLAG_COMPACT_DVINFO = 1 << 0,
+    /* the sender answers Merkle reconciliation Interests */
+    FLAG_MERKLE = 1 << 1,
+  };
+
+  static Block
+  Encode(uint64_t numPrefixes, const uint8_t* digest, size_t digestSize, uint64_t version,
+         const std::vector<Name>& neighbors, const std::string& macAddress, uint64_t flags = 0,
+         time::milliseconds maxSilence = time::milliseconds::zero());
+
+  /** @brief decodes the TLVs in @p buf, returns false if they are malformed */
+  bool
+  Decode(const uint8_t* buf, size_t size);
+
+  uint64_t
+  GetNumPrefixes() const
+  {
+    return m_numPrefixes;
+  }
+
+  uint64_t
+  GetVersion() const
+  {
+    return m_version;
+  }
+
+  uint64_t
+  GetFlags() const
+  {
+    return m_flags;
+  }
+
+  /** @brief zero if the sender did not announce it */
+  time::milliseconds
+  GetMaxSilence() const
+  {
+    return time::milliseconds(m_maxSilence);
+  }
+
+  bool
+  HasDigest() const
+  {
+    return m_digestSize > 0;
+  }
+
+  const uint8_t*
+  GetDigest() const
+  {
+    return m_digest;
+  }
+
+  size_t
+  GetDigestSize() const
+  {
+    return m_digestSize;
+  }
+
+  /** @brief whether the announced digest is @p digest */
+  bool
+  IsDigest(const uint8_t* digest, size_t size) const;
+
+  /** @brief whether @p routerPrefix is among the neighbors */
+  bool
+  HasNeighbor(const Name& routerPrefix) const;
+
+  std::string
+  GetMacAddress() const
+  {
+    return std::string(reinterpret_cast<const char*>(m_mac), m_macSize);
+  }
+
+private:
+  const uint8_t* m_begin = nullptr;
+  const uint8_t* m_end = nullptr;
+  uint64_t m_numPrefixes = 0;
+  uint64_t m_version = 0;
+  uint64_t m_flags = 0;
+  uint64_t m_maxSilence = 0;
+  const uint8_t* m_digest = nullptr;
+  size_t m_digestSize = 0;
+  const uint8_t* m_mac = nullptr;
+  size_t m_macSize = 0;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_HELLO_HPP
@@ -1,18 +1,44 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
 #include "ndvr-runner.hpp"
+
+#include <algorithm>
+
 #include <ndn-cxx/security/key-chain.hpp>
 
 namespace ndn {
 namespace ndvr {
 
-NdvrRunner::NdvrRunner(std::string& networkName, std::string& routerName, int helloInterval, std::string& validationConfig, std::vector<std::string>& namePrefixes, std::vector<std::string>& faces, std::vector<std::string>& monitorFaces)
+NdvrRunner::NdvrRunner(std::string& networkName, std::string& routerName, int helloInterval, int maxHelloInterval, std::string& validationConfig, std::vector<std::string>& namePrefixes, std::vector<std::string>& faces, std::vector<std::string>& monitorFaces, bool directFib, const std::string& fibStateFile, int probeInterval, int probeDetectMult, int dvInfoMtu, bool compactDvInfo, bool dvInfoPush, bool merkleSync, int workerThreads)
 {
   m_signingInfo = ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_ID,
                                              networkName + routerName);
   m_ndvr = std::make_shared<Ndvr>(m_signingInfo, networkName, routerName, namePrefixes, faces, monitorFaces, validationConfig);
   if (helloInterval != 0)
     m_ndvr->SetHelloInterval(helloInterval);
+  if (maxHelloInterval != 0)
+    m_ndvr->SetMaxHelloInterval(maxHelloInterval);
+  m_ndvr->SetDirectFib(directFib);
+  if (directFib) {
+    /* by default, one file per router name */
+    std::string stateFile = fibStateFile;
+    if (stateFile.empty()) {
+      stateFile = "/var/tmp/ndvrd" + networkName + routerName + ".fib";
+      std::replace(stateFile.begin() + std::string("/var/tmp/").size(), stateFile.end(), '/', '-');
+    }
+    m_ndvr->SetFibStateFile(stateFile);
+  }
+  if (probeInterval >= 0)
+    m_ndvr->SetProbeInterval(time::milliseconds(probeInterval));
+  if (probeDetectMult != 0)
+    m_ndvr->SetProbeDetectMultiplier(probeDetectMult);
+  if (dvInfoMtu > 0)
+    m_ndvr->SetDvInfoMtu(dvInfoMtu);
+  m_ndvr->SetCompactDvInfo(compactDvInfo);
+  m_ndvr->SetDvInfoPush(dvInfoPush);
+  m_ndvr->SetMerkleSync(merkleSync);
+  if (workerThreads > 0)
+    m_ndvr->SetWorkerThreads(workerThreads);
 }
 
 void
@@ -40,6 +66,17 @@ NdvrRunner::printUsage(const std::string& programName)
   std::cout << "       -p <NAME>   Specify the name prefix to be announced (can be used multiple times)" << std::endl;
   std::cout << "       -f <FACE>   Specify the face ID in which NDVR will work (can be used multiple times)" << std::endl;
   std::cout << "       -m <FACE>   Specify the face URI (remoteUri) in which NDVR will monitor for nfd/faces/events (can be used multiple times)" << std::endl;
+  std::cout << "       -i <SECS>   Specify the hello interval (Trickle Imin, default 1s)" << std::endl;
+  std::cout << "       -I <SECS>   Specify the maximum hello interval (Trickle Imax, default 2s), hellos back off up to it while nothing changes" << std::endl;
+  std::cout << "       -b <MS>     Specify the liveness probe interval on point-to-point faces (default 100ms, 0 disables)" << std::endl;
+  std::cout << "       -k <NUM>    Specify the missed probes before a neighbor is declared dead (default 3)" << std::endl;
+  std::cout << "       -u <BYTES>  Specify the maximum size of DvInfo Data packets and push Interests, DvInfo is segmented to fit it (default 1400)" << std::endl;
+  std::cout << "       -z          Send compact (front coded) DvInfo when all neighbors accept it, for low-bandwidth links" << std::endl;
+  std::cout << "       -P          Push DvInfo changes to the neighbors right away (they still pull on gaps)" << std::endl;
+  std::cout << "       -M          Reconcile with neighbors by descending their Merkle tree of buckets, fetching only the buckets that differ" << std::endl;
+  std::cout << "       -w <NUM>    Verify signatures and decode DvInfo on NUM worker threads (default 0, all on the main thread)" << std::endl;
+  std::cout << "       -F          Program routes directly on the NFD FIB (fib/add-nexthop) instead of the RIB" << std::endl;
+  std::cout << "       -S <FILE>   With -F, record the next hops installed in FILE, those left by a previous run are removed (default /var/tmp/ndvrd-<network>-<router>.fib)" << std::endl;
   std::cout << "       -h          Display usage " << std::endl;
   std::cout << "" << std::endl;
   std::cout << "SECURITY IDENTITY" << std::endl;
@@ -27,7 +27,7 @@ public:
     }
   };
 
-  NdvrRunner(std::string& networkName, std::string& routerName, int helloInterval, std::string& validationConfig, std::vector<std::string>& namePrefixes, std::vector<std::string>& faces, std::vector<std::string>& monitorFaces);
+  NdvrRunner(std::string& networkName, std::string& routerName, int helloInterval, int maxHelloInterval, std::string& validationConfig, std::vector<std::string>& namePrefixes, std::vector<std::string>& faces, std::vector<std::string>& monitorFaces, bool directFib = false, const std::string& fibStateFile = "", int probeInterval = -1, int probeDetectMult = 0, int dvInfoMtu = 0, bool compactDvInfo = false, bool dvInfoPush = false, bool merkleSync = false, int workerThreads = 0);
 
   void
   run();
@@ -5,7 +5,8 @@
 #include <cmath>
 #include <boost/algorithm/string.hpp> 
 #include <algorithm>
-#include <boost/uuid/detail/sha1.hpp>
+#include <cstring>
+#include <set>
 //#include <ns3/simulator.h>
 //#include <ns3/log.h>
 //#include <ns3/ptr.h>
@@ -53,12 +54,8 @@ void Ndvr::printRoutingTable(){
   int i = 1;
   for (auto it : m_routingTable) {
       std::string prefix = it.first;
-      std::string nextHops = "";
-      RoutingEntry e = it.second;
-      
-      for (std::string nextHop: e.GetNextHops2().GetRouterIds()){
-        nextHops+="," + nextHop;
-      }
+      RoutingEntry& e = it.second;
+      std::string nextHops = e.GetNextHops2().toString();
 
       NS_LOG_INFO("Entry:" << i++ 
                   << " Prefix: " << prefix 
@@ -74,19 +71,16 @@ void Ndvr::printRoutingTable(){
 Ndvr::Ndvr(const ndn::security::SigningInfo& signingInfo, Name network, Name routerName, std::vector<std::string>& npv, std::vector<std::string>& faces, std::vector<std::string>& monitorFaces, std::string validationConfig)
   : m_signingInfo(signingInfo)
   , m_scheduler(m_face.getIoService())
+  , m_timerWheel(m_scheduler)
   , m_validator(m_face)
   , m_seq(0)
   , m_rand_nonce(0, std::numeric_limits<int>::max())
-  , m_rand_backoff(1, 19999)
   , m_network(network)
   , m_routerName(routerName)
   , m_listenFaces(faces)
   , m_facesToBeMonitored(monitorFaces)
   , m_routingTable(m_face, m_keyChain)
-  , m_helloIntervalIni(1)
-  , m_helloIntervalCur(1)
-  , m_helloIntervalMax(5)
-  //, m_helloIntervalMax(60)
+  , m_helloTrickle(m_scheduler, [this] { SendHelloInterest(); })
   , m_localRTInterval(1)
   , m_localRTTimeout(1)
   , m_rengine(rdevice_())
@@ -101,6 +95,7 @@ Ndvr::Ndvr(const ndn::security::SigningInfo& signingInfo, Name network, Name rou
   catch (const std::exception &e ) {
     throw Error("Failed to load validation rules file=" + validationConfig + " Error=" + e.what());
   }
+  NS_LOG_INFO("Validation rules file=" << validationConfig << " fastPath=" << m_validator.HasFastPath());
 
   for (std::vector<std::string>::iterator it = npv.begin() ; it != npv.end(); ++it) {
     RoutingEntry routingEntry;
@@ -127,6 +122,10 @@ void Ndvr::Start() {
     [this](const Name&, const std::string& reason) {
       throw Error("Failed to register sync interest prefix: " + reason);
   });
+  m_face.setInterestFilter(kNdvrDvPushPrefix, std::bind(&Ndvr::processInterest, this, _2),
+    [this](const Name&, const std::string& reason) {
+      throw Error("Failed to register DvInfo push prefix: " + reason);
+  });
   Name routerKey = m_routerPrefix;
   routerKey.append("KEY");
   m_face.setInterestFilter(routerKey, std::bind(&Ndvr::OnKeyInterest, this, _2),
@@ -134,12 +133,27 @@ void Ndvr::Start() {
       throw Error("Failed to register sync interest prefix: " + reason);
   });
 
+  Name routerProbe = m_routerPrefix;
+  routerProbe.append(kProbeTag);
+  m_face.setInterestFilter(routerProbe, std::bind(&Ndvr::OnProbeInterest, this, _2),
+    [this](const Name&, const std::string& reason) {
+      throw Error("Failed to register liveness probe prefix: " + reason);
+  });
+
+  /* the first push carries the changes since the initial routing table */
+  m_lastPushedVersion = m_routingTable.GetVersion();
+
+  /* adopt the routes left on NFD by a previous run and keep NFD in sync */
+  m_routingTable.AddPermanentPrefix(kNdvrPrefix);
+  m_routingTable.StartReconciler();
+
   registerPrefixes();
 
   m_faceMonitor.onNotification.connect(std::bind(&Ndvr::onFaceEventNotification, this, _1));
   m_faceMonitor.start();
 
-  SendHelloInterest();
+  /* the hello Trickle timer starts as soon as the first face is ready (see
+   * onFaceReady) */
 }
 
 void Ndvr::Stop() {
@@ -151,7 +165,14 @@ void Ndvr::run() {
 
 void Ndvr::cleanup() {
   // TODO: remove faces
-  // TODO: remove entries from Fib
+  /* remove our routes from NFD, giving the commands a chance to go out */
+  m_routingTable.cleanup();
+  try {
+    m_face.processEvents(time::seconds(2));
+  }
+  catch (const std::exception& e) {
+    NS_LOG_WARN("Fail to remove routes on cleanup: " << e.what());
+  }
 }
 
 void Ndvr::registerNeighborPrefix(NeighborEntry& neighbor, uint64_t oldFaceId, uint64_t newFaceId) {
@@ -162,61 +183,59 @@ void Ndvr::registerNeighborPrefix(NeighborEntry& neighbor, uint64_t oldFaceId, u
   int32_t metric = CalculateCostToNeigh(neighbor, 0);
 
   if (oldFaceId != 0) {
-    m_routingTable.unregisterPrefix(neighbor.GetName(), oldFaceId);
+    m_routingTable.unregisterPrefix(neighbor.GetName(), oldFaceId, FibUpdateQueue::PRIORITY_HIGH);
   }
-  m_routingTable.registerPrefix(neighbor.GetName(), newFaceId, metric);
+  m_routingTable.registerPrefix(neighbor.GetName(), newFaceId, metric, FibUpdateQueue::PRIORITY_HIGH);
 }
 
 void
 Ndvr::registerPrefixes() {
-  for(std::string face : m_listenFaces) {
-    uint64_t faceId;
-    //std::size_t pos = faceUri.find_first_of("?");
-    //std::vector<std::string> faceProperties;
-    //if (pos!=std::string::npos) {
-    //  boost::split(faceProperties, faceUri.substr(pos+1), boost::is_any_of("&"));
-    //  faceUri[pos] = '\0';
-    //}
-
-    if (face.find_first_not_of( "0123456789" ) == std::string::npos)
-      faceId = std::stoi(face);
-    else
-      faceId = m_routingTable.createFace(face);
+  /* faces are brought up concurrently, each one becoming ready on its own */
+  for (const std::string& face : m_listenFaces)
+    bringUpFace(face);
+}
 
+void
+Ndvr::bringUpFace(const std::string& face, uint32_t attempt) {
+  if (face.find_first_not_of( "0123456789" ) == std::string::npos) {
+    uint64_t faceId = std::stoull(face);
     if (faceId == 0) {
       NS_LOG_INFO("Invalid face provided: " << face);
-      continue;
+      return;
     }
-    
-    m_routingTable.registerPrefix(kNdvrHelloPrefix.toUri(), faceId, 0);
-    m_routingTable.registerPrefix(kNdvrDvInfoPrefix.toUri(), faceId, 0);
+    onFaceReady(faceId);
+    return;
   }
-//  using namespace ns3;
-//  using namespace ns3::ndn;
-//
-//  int32_t metric = 0; // should it be 0 or std::numeric_limits<int32_t>::max() ??
-//  Ptr<Node> thisNode = NodeList::GetNode(Simulator::GetContext());
-//  NS_LOG_DEBUG("THIS node is: " << thisNode->GetId());
-//
-//  for (uint32_t deviceId = 0; deviceId < thisNode->GetNDevices(); deviceId++) {
-//    Ptr<NetDevice> device = thisNode->GetDevice(deviceId);
-//    Ptr<L3Protocol> ndn = thisNode->GetObject<L3Protocol>();
-//    NS_ASSERT_MSG(ndn != nullptr, "Ndn stack should be installed on the node");
-//
-//    auto face = ndn->getFaceByNetDevice(device);
-//    NS_ASSERT_MSG(face != nullptr, "There is no face associated with the net-device");
-//
-//    NS_LOG_DEBUG("FibHelper::AddRoute prefix=" << kNdvrPrefix << " via faceId=" << face->getId());
-//    FibHelper::AddRoute(thisNode, kNdvrHelloPrefix, face, metric);
-//    FibHelper::AddRoute(thisNode, kNdvrDvInfoPrefix, face, metric);
-//
-//    auto addr = device->GetAddress();
-//    if (m_enableUnicastFaces && Mac48Address::IsMatchingType(addr)) {
-//      m_macaddr = boost::lexical_cast<std::string>(Mac48Address::ConvertFrom(addr));
-//      NS_LOG_DEBUG("Save mac =" << m_macaddr);
-//    }
-//  }
-//
+
+  m_routingTable.createFace(face,
+    [this] (uint64_t faceId) { onFaceReady(faceId); },
+    [this, face, attempt] (const std::string& reason) {
+      if (attempt >= kFaceCreateRetries) {
+        NS_LOG_WARN("Giving up on face " << face << ": " << reason);
+        return;
+      }
+      auto delay = time::seconds(1 << attempt);
+      NS_LOG_INFO("Fail to bring up face " << face << " (" << reason << "), retrying in " << delay);
+      m_scheduler.schedule(delay, [this, face, attempt] { bringUpFace(face, attempt + 1); });
+    });
+}
+
+/* A face is ready once NFD routes our hello/dvinfo prefixes through it, only
+ * then it makes sense to send hellos */
+void
+Ndvr::onFaceReady(uint64_t faceId) {
+  NS_LOG_INFO("Registering NDVR prefixes on faceId=" << faceId);
+  m_routingTable.registerPrefix(kNdvrHelloPrefix.toUri(), faceId, 0, FibUpdateQueue::PRIORITY_HIGH,
+    [this, faceId] {
+      NS_LOG_INFO("Face ready faceId=" << faceId);
+      if (m_helloTrickle.IsRunning())
+        m_helloTrickle.Reset();
+      else
+        m_helloTrickle.Start();
+    });
+  m_routingTable.registerPrefix(kNdvrDvInfoPrefix.toUri(), faceId, 0, FibUpdateQueue::PRIORITY_HIGH);
+  if (m_dvInfoPush)
+    m_routingTable.registerPrefix(kNdvrDvPushPrefix.toUri(), faceId, 0, FibUpdateQueue::PRIORITY_HIGH);
 }
 
 void
@@ -234,6 +253,9 @@ Ndvr::onFaceEventNotification(const ndn::nfd::FaceEventNotification& faceEventNo
     case ndn::nfd::FACE_EVENT_DOWN:
     case ndn::nfd::FACE_EVENT_DESTROYED: {
       uint64_t faceId = faceEventNotification.getFaceId();
+      /* NFD drops the routes of destroyed faces by itself */
+      if (faceEventNotification.getKind() == ndn::nfd::FACE_EVENT_DESTROYED)
+        m_routingTable.onFaceDestroyed(faceId);
       
       for (auto it = m_neighMap.begin(); it != m_neighMap.end(); ++it) {
         if (it->second.GetFaceId() == faceId) {
@@ -258,8 +280,7 @@ Ndvr::onFaceEventNotification(const ndn::nfd::FaceEventNotification& faceEventNo
       if (foundFaceUri != m_facesToBeMonitored.end() && faceId != 0) {
         NS_LOG_DEBUG("Face creation event matches facesMonitor: " << faceUri
                         << ". New Face ID: " << faceEventNotification.getFaceId() << ". Registering NDVR prefixes.");
-        m_routingTable.registerPrefix(kNdvrHelloPrefix.toUri(), faceId, 0);
-        m_routingTable.registerPrefix(kNdvrDvInfoPrefix.toUri(), faceId, 0);
+        onFaceReady(faceId);
       }
       break;
     }
@@ -268,9 +289,9 @@ Ndvr::onFaceEventNotification(const ndn::nfd::FaceEventNotification& faceEventNo
   }
 }
 
-std::string
+std::vector<Name>
 Ndvr::GetNeighborToken() {
-  std::string res;
+  std::vector<Name> res;
 
   if (!m_neighMap.size()) {
     m_pivot = m_neighMap.end();
@@ -285,7 +306,7 @@ Ndvr::GetNeighborToken() {
     for (;r>0;r--)
       m_pivot++;
   }
-  res.append(m_pivot->first);
+  res.emplace_back(m_pivot->first);
 
   if (m_neighMap.size() == 1)
     return res;
@@ -293,77 +314,65 @@ Ndvr::GetNeighborToken() {
   if (++m_pivot == m_neighMap.end()) {
     m_pivot = m_neighMap.begin();
   }
-  res.append("&");
-  res.append(m_pivot->first);
+  res.emplace_back(m_pivot->first);
 
   return res;
 }
 
 void
 Ndvr::SendHelloInterest() {
-  /* check whether exists a scheduled SendHelloInterest son. If that is so, 
-   * skip this call */
-  auto diff = time::duration_cast<time::seconds>(
-      m_nextHelloTime - time::steady_clock::now());
-  if (diff > time::seconds(0) && diff <= time::seconds(m_helloIntervalIni)) {
-    NS_LOG_DEBUG("Ignoring SendHelloInterest, it will be called in " << diff);
-    return;
-  }
-
-  /* First of all, cancel any previously scheduled events */
-  sendhello_event.cancel();
-
   Name name = Name(kNdvrHelloPrefix);
   name.append(getRouterPrefix());
-  name.appendNumber(m_routingTable.size());
-  name.append(m_routingTable.GetDigest());
-  name.appendNumber(m_routingTable.GetVersion());
-  NS_LOG_INFO("Sending Interest " << name);
+
+  /* one NEIGHBOR TLV per router holding the token */
+  std::vector<Name> neighbors = GetNeighborToken();
+  for (const auto& neighbor : neighbors) {
+    NS_LOG_INFO("neighbors_token " << neighbor);
+  }
+  uint8_t digest[IncrementalDigest::kSize];
+  size_t digestSize = m_routingTable.GetDigestBytes(digest);
 
   Interest interest = Interest();
   interest.setNonce(m_rand_nonce(m_rengine));
   interest.setName(name);
   interest.setCanBePrefix(false);
   interest.setInterestLifetime(time::milliseconds(0));
-  std::string params;
-  if (m_neighMap.size() > 0) {
-    auto neighbors_token = GetNeighborToken();
-    NS_LOG_INFO("neighbors_token " << neighbors_token);
-    params = neighbors_token;
-  }
-  if (m_enableUnicastFaces) {
-    params = params + "&" + m_macaddr;
-  }
-  if (!params.empty()) {
-    interest.setApplicationParameters(make_span(reinterpret_cast<const uint8_t*>(params.c_str()), params.size()));
-  }
+  interest.setApplicationParameters(HelloParams::Encode(m_routingTable.size(), digest, digestSize,
+                                                        m_routingTable.GetVersion(), neighbors,
+                                                        m_enableUnicastFaces ? m_macaddr : std::string(),
+                                                        HelloParams::FLAG_COMPACT_DVINFO | HelloParams::FLAG_MERKLE,
+                                                        m_helloTrickle.GetMaxSilence()));
+  NS_LOG_INFO("Sending Interest " << name << " numPrefixes=" << m_routingTable.size() << " digest=" << m_routingTable.GetDigest() << " version=" << m_routingTable.GetVersion());
 
   m_face.expressInterest(interest, [](const Interest&, const Data&) {},
                         [](const Interest&, const lp::Nack&) {},
                         [](const Interest&) {});
-
-  m_nextHelloTime = time::steady_clock::now() + time::seconds(m_helloIntervalCur);
-  sendhello_event = m_scheduler.schedule(time::seconds(m_helloIntervalCur),
-                                        [this] { SendHelloInterest(); });
 }
 
 void
 Ndvr::UpdateNeighHelloTimeout(NeighborEntry& neighbor) {
-  auto diff = neighbor.GetLastSeenDelta();
-  time::seconds timeout = time::seconds(2) + 1*std::max(time::seconds(m_helloIntervalCur), diff);
+  /* neighbors announce how long they may stay silent (2.5 * their Imax, see
+   * TrickleTimer), those that do not are assumed to use our Imax */
+  time::milliseconds maxSilence = neighbor.GetMaxSilence();
+  if (maxSilence == time::milliseconds::zero())
+    maxSilence = m_helloTrickle.GetMaxSilence();
+  maxSilence = std::min<time::milliseconds>(maxSilence, kMaxHelloSilence);
+  time::seconds timeout = time::seconds(2) + time::duration_cast<time::seconds>(maxSilence + time::milliseconds(999));
   neighbor.SetHelloTimeout(timeout);
 }
 
 void
 Ndvr::RescheduleNeighRemoval(NeighborEntry& neighbor) {
-  neighbor.removal_event.cancel();
   const std::string neigh_prefix = neighbor.GetName();
-  neighbor.removal_event = m_scheduler.schedule(neighbor.GetHelloTimeout(),
+  m_timerWheel.schedule(neighbor.removal_event, neighbor.GetHelloTimeout(),
                             // TODO: confirm the timeout is because the neighbor is no longer reachable
                             //  or it is just busy and couldnt answer (or the shared medium is busy)
                             //[this, neigh_prefix] { ConfirmNeighTimeout(neigh_prefix); });
                             [this, neigh_prefix] { RemoveNeighbor(neigh_prefix); });
   neighbor.UpdateLastSeen();
+  /* the neighbor is alive, keep the routes through it on NFD */
+  m_routingTable.RefreshFace(neighbor.GetFaceId(),
+      time::duration_cast<time::milliseconds>(kRouteExpirationFactor * neighbor.GetHelloTimeout()));
 }
 
 /*
@@ -384,19 +393,41 @@ Ndvr::RemoveNeighbor(const std::string neigh) {
   }
 
   bool has_changed = false;
+  uint64_t faceId = neigh_it->second.GetFaceId();
+  neigh_it->second.removal_event.cancel();
+  neigh_it->second.dvinfo_event.cancel();
+  neigh_it->second.probe_event.cancel();
+  neigh_it->second.probe_timeout_event.cancel();
+  m_dvInfoFetchQueue.erase(std::remove(m_dvInfoFetchQueue.begin(), m_dvInfoFetchQueue.end(), neigh),
+                           m_dvInfoFetchQueue.end());
+  auto fetch_it = m_dvInfoFetches.find(neigh);
+  if (fetch_it != m_dvInfoFetches.end())
+    EndDvInfoFetch(fetch_it);
+  m_merkleSyncs.erase(neigh);
+
+  /* Routes through the neighbor are soft state on NFD: once nobody else
+   * keeps the face alive, they are no longer refreshed and ExpireFace
+   * unregisters all of them (including the ones no longer in the routing
+   * table). In direct FIB mode (no expiration), or when another neighbor is
+   * still on the face, the routes through the neighbor are unregistered
+   * one by one below */
+  bool expire = !m_routingTable.IsDirectFib() && CountNeighborsOnFace(faceId) == 1;
+  if (expire)
+    m_routingTable.ExpireFace(faceId);
 
   // remove all routes whose next-hop is this neighbor (instead of remove, we increase the cost)
   for (auto it = m_routingTable.begin(); it != m_routingTable.end(); ++it) {
-    if (it->second.isNextHop(neigh_it->second.GetFaceId())) {
-      it->second.SetNextHopCost(neigh_it->second.GetFaceId(),
+    if (it->second.isNextHop(faceId)) {
+      m_routingTable.SetNextHopCost(it->second, faceId,
           std::numeric_limits<uint32_t>::max());
-      m_routingTable.unregisterPrefix(it->first, neigh_it->second.GetFaceId());
-      it->second.IncSeqNum(1);
+      if (!expire)
+        m_routingTable.unregisterPrefix(it->first, faceId);
+      m_routingTable.IncSeqNum(it->second, 1);
       has_changed = true;
     }
     /* For local routes, increment the seqNum by 2 */
     if (it->second.isDirectRoute()) {
-      it->second.IncSeqNum(2);
+      m_routingTable.IncSeqNum(it->second, 2);
       has_changed = true;
     }
     // Now that we removed a NextHop, we eventually need to update the
@@ -414,9 +445,9 @@ Ndvr::RemoveNeighbor(const std::string neigh) {
 
   if (has_changed) {
     m_routingTable.IncVersion();
-  //  /* schedule a immediate ehlo message to notify neighbors about a new DvInfo */
-  //  ResetHelloInterval();
-    SendHelloInterest();
+    /* notify neighbors about a new DvInfo within the minimum hello interval */
+    m_helloTrickle.Reset();
+    SchedDvInfoPush();
   }
   // TODO: list my RIB
   NS_LOG_DEBUG("m_routingTable (one rib-entry per line)");
@@ -425,72 +456,166 @@ Ndvr::RemoveNeighbor(const std::string neigh) {
   }
 }
 
+/* The backoff before asking a neighbor for its DvInfo comes from the RTT
+ * of its DvInfo Interests and from how many neighbors share its face:
+ *  - if we do not hold the neighbor's token (see GetNeighborToken), we wait
+ *    one RTO, the time the token holders take to fetch it, so it serves
+ *    them first and groups our Interests into the same reply;
+ *  - on a shared (multicast) face, the Interests are spread over one slot
+ *    per other neighbor to avoid collisions. The slot is the RTT variation,
+ *    which grows with the contention on the medium (up to kDvInfoMaxSlot).
+ * A neighbor alone on its face is asked right away.
+ */
 void Ndvr::SchedDvInfoInterest(NeighborEntry& neighbor, bool wait, uint32_t retx) {
   auto n = neighbor.GetName();
 
   /* is there any other DvInfo interest scheduled? if so, skip */
-  auto n_event = dvinfointerest_event.find(n);
-  if (n_event != dvinfointerest_event.end() && n_event->second)
+  if (neighbor.dvinfo_event)
     return;
 
-  /* exponential Backoff */
-  /*
-  uint32_t max_rand = pow(2, m_c) - 1;
-  std::uniform_int_distribution<int> rand(0, max_rand);
-  int r = rand(m_rengine);
-  int backoffTime = r*m_slotTime;
-
-  if (backoffTime > 500000)
-    backoffTime = 500000;
-
-  // random factor to avoid tx collisions
-  backoffTime += 10000*m_nodeid;
-
-  NS_LOG_INFO("SchedDvInfoInterest name=" << n << " rand=" << r << " backoffTime=" << backoffTime);
-  */
-
-  /* token based Backoff */
-  int backoffTime = 0;
+  const auto& rtt = neighbor.dvInfoRtt;
+  time::nanoseconds backoffTime = time::nanoseconds::zero();
   if (wait)
-    backoffTime = 750000;
-  /* workaround to avoid wifi collisions */
-  backoffTime += 10*m_rand_backoff(m_rengine);
-  NS_LOG_INFO("SchedDvInfoInterest name=" << n << " wait=" << wait << " backoffTime=" << backoffTime);
+    backoffTime = rtt.getEstimatedRto();
+  size_t density = CountNeighborsOnFace(neighbor.GetFaceId());
+  if (density > 1) {
+    time::nanoseconds slot = kDvInfoMaxSlot;
+    /* there is no RTT variation until the first sample */
+    if (rtt.getRttVariation() > time::nanoseconds::zero())
+      slot = std::min(slot, rtt.getRttVariation());
+    std::uniform_int_distribution<int64_t> rand(0, slot.count() * static_cast<int64_t>(density - 1));
+    backoffTime += time::nanoseconds(rand(m_rengine));
+  }
+  NS_LOG_INFO("SchedDvInfoInterest name=" << n << " wait=" << wait << " density=" << density << " rto=" << time::duration_cast<time::milliseconds>(rtt.getEstimatedRto()).count() << "ms backoffTime=" << time::duration_cast<time::microseconds>(backoffTime).count());
+
+  m_timerWheel.schedule(neighbor.dvinfo_event, backoffTime,
+                        [this, n, retx] { SendDvInfoInterest(n, retx); });
+}
 
-  dvinfointerest_event[n] = m_scheduler.schedule(
-                                time::microseconds(backoffTime),
-                                [this, n, retx] { SendDvInfoInterest(n, retx); });
+/* neighbors reached through @p faceId (more than one on a multicast face) */
+size_t Ndvr::CountNeighborsOnFace(uint64_t faceId) {
+  size_t n = 0;
+  for (auto& neigh : m_neighMap)
+    if (neigh.second.GetFaceId() == faceId)
+      n++;
+  return n;
 }
 
 void
 Ndvr::SendDvInfoInterest(const std::string& neighbor_name, uint32_t retx) {
-  /* cleanup scheduled event */
-  dvinfointerest_event.erase(neighbor_name);
+  auto neigh_it = m_neighMap.find(neighbor_name);
+  if (neigh_it == m_neighMap.end()) {
+    return;
+  }
+  auto& neighbor = neigh_it->second;
+  /* nothing newer than what we have already applied (e.g., it was pushed) */
+  if (neighbor.GetAppliedVersion() > 0 && neighbor.GetAppliedVersion() >= neighbor.GetVersion()) {
+    NS_LOG_INFO("DV-Info version=" << neighbor.GetVersion() << " already applied from neighbor=" << neighbor_name);
+    return;
+  }
 
+  /* neighbors supporting it are reconciled bucket by bucket */
+  if (m_merkleSync && (neighbor.GetHelloFlags() & HelloParams::FLAG_MERKLE)) {
+    if (neighbor.IsMerkleSynced()) {
+      NS_LOG_INFO("Merkle root already in sync with neighbor=" << neighbor_name);
+      return;
+    }
+    /* with nothing to compare with yet, every bucket differs: pull the
+     * DvInfo, its leaves are learned once it is applied */
+    if (neighbor.HasMerkleLeaves()) {
+      StartMerkleSync(neighbor_name);
+      return;
+    }
+  }
+  PullDvInfo(neighbor_name, retx);
+}
+
+void
+Ndvr::PullDvInfo(const std::string& neighbor_name, uint32_t retx) {
   auto neigh_it = m_neighMap.find(neighbor_name);
   if (neigh_it == m_neighMap.end()) {
     return;
   }
-  auto neighbor = neigh_it->second;
+  auto& neighbor = neigh_it->second;
 
-  NS_LOG_INFO("Sending DV-Info Interest retx=" << retx << " to neighbor=" << neighbor_name);
   Name name = Name(kNdvrDvInfoPrefix);
   name.append(neighbor_name);
   name.appendNumber(neighbor.GetVersion());
+  /* ask only for the changes since the last version we have applied */
+  if (neighbor.GetAppliedVersion() > 0)
+    name.appendNumber(neighbor.GetAppliedVersion());
+
+  /* a new transfer waits if there are too many already */
+  if (m_dvInfoFetches.count(neighbor_name) == 0 && m_dvInfoFetches.size() >= kDvInfoMaxFetches) {
+    if (std::find(m_dvInfoFetchQueue.begin(), m_dvInfoFetchQueue.end(), neighbor_name) == m_dvInfoFetchQueue.end())
+      m_dvInfoFetchQueue.push_back(neighbor_name);
+    NS_LOG_INFO("Too many DV-Info transfers, neighbor=" << neighbor_name << " waits queued=" << m_dvInfoFetchQueue.size());
+    return;
+  }
+  auto& fetch = m_dvInfoFetches[neighbor_name];
+  if (fetch.name == name && fetch.nInFlight > 0) {
+    NS_LOG_INFO("DV-Info already being fetched name=" << name);
+    return;
+  }
+  NS_LOG_INFO("Sending DV-Info Interest retx=" << retx << " to neighbor=" << neighbor_name);
+  /* a transfer of an older version is abandoned, its segments are ignored */
+  fetch = DvInfoFetch();
+  fetch.name = name;
+  /* the number of segments is only known after segment 0 */
+  SendDvInfoSegment(neighbor, fetch, 0);
+  fetch.nextSegment = 1;
+}
 
+void
+Ndvr::SendDvInfoSegment(NeighborEntry& neighbor, DvInfoFetch& fetch, uint64_t segment, uint32_t retx) {
   Interest interest = Interest();
   interest.setNonce(m_rand_nonce(m_rengine));
-  interest.setName(name);
-  interest.setCanBePrefix(false);
+  /* segment 0 comes from whatever encoding is current, the others from the
+   * same encoding as segment 0 */
+  if (fetch.encodedName.empty()) {
+    interest.setName(fetch.name);
+    interest.setCanBePrefix(true);
+  }
+  else {
+    interest.setName(Name(fetch.encodedName).appendSegment(segment));
+    interest.setCanBePrefix(false);
+  }
   interest.setMustBeFresh(true);
-  interest.setInterestLifetime(time::seconds(m_localRTTimeout));
+  /* exponential backoff of the retransmissions of this segment only: the
+   * RTO, shared by all the Interests to the neighbor, is left alone */
+  auto rto = time::duration_cast<time::milliseconds>(neighbor.dvInfoRtt.getEstimatedRto());
+  auto lifetime = rto * (1 << std::min<uint32_t>(retx, kDvInfoSegmentRetries));
+  interest.setInterestLifetime(std::max(rto, std::min(lifetime, kDvInfoMaxLifetime)));
 
+  fetch.nInFlight++;
   m_face.expressInterest(interest,
-    std::bind(&Ndvr::OnDvInfoContent, this, _1, _2),
-    std::bind(&Ndvr::OnDvInfoNack, this, _1, _2),
+    std::bind(&Ndvr::OnDvInfoContent, this, _1, _2, retx, time::steady_clock::now()),
+    std::bind(&Ndvr::OnDvInfoNack, this, _1, _2, retx),
     std::bind(&Ndvr::OnDvInfoTimedOut, this, _1, retx));
 }
 
+/* the transfer a DvInfo segment belongs to, or end() if there is no such
+ * transfer anymore (completed, abandoned or replaced by a newer version) */
+Ndvr::DvInfoFetchMap::iterator
+Ndvr::FindDvInfoFetch(const Name& segmentName) {
+  std::string neighPrefix = ExtractRouterPrefix(segmentName, kNdvrDvInfoPrefix);
+  auto it = m_dvInfoFetches.find(neighPrefix);
+  if (it == m_dvInfoFetches.end() || it->second.name != GetDvInfoBaseName(segmentName))
+    return m_dvInfoFetches.end();
+  return it;
+}
+
+/* ends a DvInfo transfer (completed or not), so a waiting neighbor can start
+ * its own */
+void Ndvr::EndDvInfoFetch(DvInfoFetchMap::iterator fetch_it) {
+  m_dvInfoFetches.erase(fetch_it);
+  while (!m_dvInfoFetchQueue.empty() && m_dvInfoFetches.size() < kDvInfoMaxFetches) {
+    std::string neighbor_name = m_dvInfoFetchQueue.front();
+    m_dvInfoFetchQueue.pop_front();
+    SendDvInfoInterest(neighbor_name);
+  }
+}
+
 uint64_t Ndvr::ExtractIncomingFace(const ndn::Interest& interest) {
   /** Incoming Face Indication
    * NDNLPv2 says "Incoming face indication feature allows the forwarder to inform local applications
@@ -528,25 +653,12 @@ void Ndvr::processInterest(const ndn::Interest& interest) {
     return OnHelloInterest(interest, inFaceId);
   else if (kNdvrDvInfoPrefix.isPrefixOf(interestName))
     return OnDvInfoInterest(interest);
+  else if (kNdvrDvPushPrefix.isPrefixOf(interestName))
+    return OnDvPushInterest(interest);
 
   NS_LOG_INFO("Unknown Interest " << interestName);
 }
 
-void Ndvr::IncreaseHelloInterval() {
-  /* exponetially increase the helloInterval until the maximum allowed */
-  if (increasehellointerval_event)
-    return;
-  increasehellointerval_event = m_scheduler.schedule(time::seconds(1),
-      [this] {
-        m_helloIntervalCur = (2*m_helloIntervalCur > m_helloIntervalMax) ? m_helloIntervalMax : 2*m_helloIntervalCur;
-      });
-}
-
-void Ndvr::ResetHelloInterval() {
-  increasehellointerval_event.cancel();
-  m_helloIntervalCur = m_helloIntervalIni;
-}
-
 void Ndvr::OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId) {
   const ndn::Name interestName(interest.getName());
   NS_LOG_INFO("Received HELLO Interest " << interestName);
@@ -561,28 +673,27 @@ void Ndvr::OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId) {
     return;
   }
 
-  uint32_t numPrefixes = ExtractNumPrefixesFromAnnounce(interestName);
-  std::string digest = ExtractDigestFromAnnounce(interestName);
-  uint32_t version = ExtractVersionFromAnnounce(interestName);
-  std::vector<std::string> params;
-  if (interest.hasApplicationParameters() && interest.getApplicationParameters().value_size() > 0) {
-    std::string s;
-    s.assign((char *)interest.getApplicationParameters().value(), interest.getApplicationParameters().value_size());
-    NS_LOG_INFO("Neighbor=" << neighPrefix <<  " params=" << s);
-    boost::split(params, s, boost::is_any_of("&"));
-  }
-  std::string neigh_mac;
-  if (m_enableUnicastFaces) {
-    neigh_mac = params.back();
-    params.pop_back();
-    NS_LOG_INFO("Neighbor_mac == " << neigh_mac);
+  HelloParams hello;
+  if (!interest.hasApplicationParameters() ||
+      !hello.Decode(interest.getApplicationParameters().value(), interest.getApplicationParameters().value_size())) {
+    NS_LOG_INFO("Invalid hello parameters, ignoring...");
+    return;
   }
+  uint32_t numPrefixes = hello.GetNumPrefixes();
+  uint32_t version = hello.GetVersion();
+  uint8_t digest[IncrementalDigest::kSize];
+  bool sameDigest = hello.HasDigest() && hello.IsDigest(digest, m_routingTable.GetDigestBytes(digest));
+  NS_LOG_INFO("Neighbor=" << neighPrefix << " numPrefixes=" << numPrefixes << " version=" << version << " sameDigest=" << sameDigest);
 
   auto neigh = m_neighMap.find(neighPrefix);
   bool newNeigh = false;
   if (neigh == m_neighMap.end()) {
-    //ResetHelloInterval();
     uint64_t neighFaceId = 0;
+    std::string neigh_mac;
+    if (m_enableUnicastFaces) {
+      neigh_mac = hello.GetMacAddress();
+      NS_LOG_INFO("Neighbor_mac == " << neigh_mac);
+    }
     if (m_enableUnicastFaces && !neigh_mac.empty()) {
       auto neighFaceId_it = m_neighToFaceId.find(neighPrefix);
       if (neighFaceId_it == m_neighToFaceId.end()) {
@@ -600,8 +711,9 @@ void Ndvr::OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId) {
     uint64_t oldFaceId = 0;
     registerNeighborPrefix(neigh->second, oldFaceId, neighFaceId);
     newNeigh = true;
+    StartProbing(neighPrefix);
   } else {
-    NS_LOG_INFO("Already known router, increasing the hello interval");
+    NS_LOG_INFO("Already known router");
     if (neigh->second.GetFaceId() != inFaceId) {
       /* Issue #2: TODO: We need to be careful about this because since we are using default multicast forward strategy,
        * mean that one node can forward ndvr messages from other nodes, so the interest might be received from
@@ -609,9 +721,22 @@ void Ndvr::OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId) {
       //NS_LOG_INFO("Neighbor moved from faceId=" << neigh->second.GetFaceId() << " to faceId=" << inFaceId << " neigh=" << neighPrefix);
       //registerNeighborPrefix(neigh->second, neigh->second.GetFaceId(), inFaceId);
     }
-    //IncreaseHelloInterval();
     //return;
   }
+
+  neigh->second.SetHelloFlags(hello.GetFlags());
+  neigh->second.SetMaxSilence(hello.GetMaxSilence());
+  neigh->second.SetAnnouncedDigest(hello.GetDigest(), hello.GetDigestSize());
+
+  /* Trickle: a hello telling nothing new counts towards suppressing ours,
+   * a new neighbor or one with a newer table brings the interval back to
+   * the minimum */
+  bool consistent = !newNeigh && (numPrefixes == 0 || version <= neigh->second.GetVersion() || sameDigest);
+  if (consistent)
+    m_helloTrickle.HearConsistent();
+  else
+    m_helloTrickle.Reset();
+
   UpdateNeighHelloTimeout(neigh->second);
   RescheduleNeighRemoval(neigh->second);
   //if (numPrefixes > 0 && (newNeigh || version > neigh->second.GetVersion()) && numPrefixes >= m_routingTable.size()) {
@@ -619,16 +744,13 @@ void Ndvr::OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId) {
     neigh->second.SetVersion(version);
 
     /* does we really have a change? */
-    if (digest != "0" && digest == m_routingTable.GetDigest()) {
-      NS_LOG_INFO("Same digest, so there was no change! digest=" << digest);
+    if (sameDigest) {
+      NS_LOG_INFO("Same digest, so there was no change! digest=" << m_routingTable.GetDigest());
       return;
     }
 
     /* should we request immediatly or wait? */
-    bool wait = true;
-    auto it = std::find(params.begin(), params.end(), m_routerPrefix);
-    if (it != params.end())
-      wait = false;
+    bool wait = !hello.HasNeighbor(m_routerPrefix);
     SchedDvInfoInterest(neigh->second, wait);
   } else {
     NS_LOG_INFO("Skipped DvInfoInterest numPrefixes=" << numPrefixes << " m_routingTable.size()=" << m_routingTable.size() << " newNeigh=" << newNeigh << " version=" << version << " saved_version=" << neigh->second.GetVersion());
@@ -645,30 +767,258 @@ void Ndvr::OnDvInfoInterest(const ndn::Interest& interest) {
     return;
   }
 
-  /* group DvInfo replies to avoid duplicates */
+  if (IsMerkleName(interest.getName()))
+    return ReplyMerkleInterest(interest);
+
+  /* group DvInfo replies to avoid duplicates (neighbors asking for the
+   * same name get a single reply, different "since" versions get their own) */
+  m_pendingDvInfoReplies.emplace(interest.getName(), interest);
   if (replydvinfo_event)
     return;
   replydvinfo_event = m_scheduler.schedule(time::milliseconds(replydvinfo_dist(m_rengine)),
-      [this, interest] {
-        ReplyDvInfoInterest(interest);
+      [this] {
+        auto pending = std::move(m_pendingDvInfoReplies);
+        m_pendingDvInfoReplies.clear();
+        for (auto& it : pending)
+          ReplyDvInfoInterest(it.second);
       });
 }
 
 void Ndvr::ReplyDvInfoInterest(const ndn::Interest& interest) {
-  auto data = std::make_shared<ndn::Data>(interest.getName());
-  data->setFreshnessPeriod(ndn::time::milliseconds(1000));
+  const Name& name = interest.getName();
+
+  /* a transfer starts with an Interest for the DvInfo name (CanBePrefix),
+   * answered with segment 0 of the current encoding. The following segments
+   * are asked for by the name of that encoding, so they come from it even
+   * if the routing table has changed meanwhile */
+  DvInfoSegments* segments = nullptr;
+  uint64_t segment = 0;
+  if (name.empty() || !name.get(-1).isSegment()) {
+    segments = &GetCurrentDvInfoSegments(name);
+  }
+  else {
+    segment = name.get(-1).toSegment();
+    Name encodedName = name.getPrefix(-1);
+    auto it = m_dvInfoCache.find(encodedName);
+    if (encodedName.empty() || !encodedName.get(-1).isVersion() || it == m_dvInfoCache.end()) {
+      NS_LOG_INFO("DV-Info segment of an unknown encoding, ignoring.. I=" << name);
+      return;
+    }
+    m_dvInfoCacheHits++;
+    segments = &it->second;
+    segments->lastUsed = time::steady_clock::now();
+  }
+
+  if (segment >= segments->segments.size()) {
+    NS_LOG_INFO("DV-Info segment out of range, ignoring.. I=" << name << " nSegments=" << segments->segments.size());
+    return;
+  }
+  /* every segment put without being signed for it saves a signature, but
+   * re-encodings after a routing table change sign segments that may never
+   * be asked for, so it can go negative */
+  m_dvInfoSegmentsServed++;
+  int64_t signaturesSaved = int64_t(m_dvInfoSegmentsServed) - int64_t(m_dvInfoSegmentsSigned);
+  NS_LOG_INFO("Replying DV-Info segment=" << segment << "/" << segments->segments.size() << " I=" << name << " hits=" << m_dvInfoCacheHits << " misses=" << m_dvInfoCacheMisses << " signaturesSaved=" << signaturesSaved);
+  m_face.put(*segments->segments[segment]);
+}
+
+/* the segments of @p dvInfoName for the current routing table version and
+ * encoding, from the cache or encoded and signed now. A new encoding never
+ * replaces an older one in place: it gets its own name */
+DvInfoSegments& Ndvr::GetCurrentDvInfoSegments(const Name& dvInfoName) {
+  PruneDvInfoCache();
+  auto current = m_currentDvInfo.find(dvInfoName);
+  if (current != m_currentDvInfo.end()) {
+    auto it = m_dvInfoCache.find(current->second);
+    if (it != m_dvInfoCache.end() && it->second.version == m_routingTable.GetVersion() &&
+        it->second.compact == UseCompactDvInfo()) {
+      m_dvInfoCacheHits++;
+      it->second.lastUsed = time::steady_clock::now();
+      return it->second;
+    }
+  }
+  m_dvInfoCacheMisses++;
+  /* encoding versions only grow, also across restarts */
+  m_lastDvInfoEncoding = std::max<uint64_t>(m_lastDvInfoEncoding + 1,
+      time::toUnixTimestamp(time::system_clock::now()).count());
+  Name encodedName = Name(dvInfoName).appendVersion(m_lastDvInfoEncoding);
+  m_currentDvInfo[dvInfoName] = encodedName;
+  auto& segments = m_dvInfoCache[encodedName];
+  BuildDvInfoSegments(encodedName, segments);
+  segments.lastUsed = time::steady_clock::now();
+  return segments;
+}
+
+void Ndvr::BuildDvInfoSegments(const Name& encodedName, DvInfoSegments& out) {
+  Name dvInfoName = GetDvInfoBaseName(encodedName);
   // Set dvinfo
   std::string dvinfo_str;
-  if (interest.getName().get(-1).toNumber() > 0) {
-    EncodeDvInfo(dvinfo_str);
+  out.name = encodedName;
+  out.compact = UseCompactDvInfo();
+  bool merkle = IsMerkleName(dvInfoName);
+  if (merkle) {
+    /* a Merkle bucket: its digest, then its entries */
+    size_t bucket = dvInfoName.get(-1).toNumber();
+    auto digest = m_routingTable.GetMerkleDigest().bucket(bucket).toFixedBytes();
+    dvinfo_str.append(digest.begin(), digest.end());
+    EncodeDvInfoBucket(dvinfo_str, bucket);
   }
-  NS_LOG_INFO("Replying DV-Info with encoded data: size=" << dvinfo_str.size() << " I=" << interest.getName());
-  //NS_LOG_INFO("Sending DV-Info encoded: str=" << dvinfo_str);
-  data->setContent(make_span(reinterpret_cast<const uint8_t*>(dvinfo_str.c_str()), dvinfo_str.size()));
-  // Sign and send
-  m_keyChain.sign(*data, m_signingInfo);
-  //m_keyChain.sign(*data);
-  NS_LOG_INFO("Replying DV-Info success!");
+  else if (ExtractVersionFromDvInfo(dvInfoName) > 0) {
+    EncodeDvInfo(dvinfo_str, ExtractSinceVersionFromDvInfo(dvInfoName), out.compact);
+  }
+
+  size_t segmentSize = GetDvInfoSegmentSize();
+  uint64_t nSegments = std::max<uint64_t>(1, (dvinfo_str.size() + segmentSize - 1) / segmentSize);
+  NS_LOG_INFO("Encoding DV-Info: size=" << dvinfo_str.size() << " segmentSize=" << segmentSize << " nSegments=" << nSegments << " name=" << encodedName);
+
+  out.version = m_routingTable.GetVersion();
+  out.segments.clear();
+  for (uint64_t i = 0; i < nSegments; i++) {
+    auto data = std::make_shared<ndn::Data>(Name(encodedName).appendSegment(i));
+    /* bucket digests change with the routing table, they must not be cached */
+    data->setFreshnessPeriod(ndn::time::milliseconds(merkle ? 0 : 1000));
+    data->setFinalBlock(name::Component::fromSegment(nSegments - 1));
+    size_t offset = i * segmentSize;
+    size_t size = std::min(segmentSize, dvinfo_str.size() - std::min(offset, dvinfo_str.size()));
+    data->setContent(make_span(reinterpret_cast<const uint8_t*>(dvinfo_str.data()) + offset, size));
+    // Sign and send
+    m_keyChain.sign(*data, m_signingInfo);
+    m_dvInfoSegmentsSigned++;
+    /* encode the wire once, so that cache hits just put the same block */
+    data->wireEncode();
+    out.segments.push_back(data);
+  }
+}
+
+/* DvInfo bytes that fit a segment: m_dvInfoMtu minus the overhead of the
+ * Data packet (name, MetaInfo and signature), measured once on an empty
+ * segment with the longest name we can produce. With pushes, it also leaves
+ * room for the push Interest the segment is carried in, so that a DvInfo
+ * that fits a segment can be pushed within the MTU as well */
+size_t Ndvr::GetDvInfoSegmentSize() {
+  if (m_dvInfoSegmentSize > 0)
+    return m_dvInfoSegmentSize;
+
+  static const size_t kMinSegmentSize = 256;
+  /* content TLV header and ECDSA signature length variation */
+  static const size_t kOverheadSlack = 8;
+  /* longer than both DvInfo and Merkle bucket names */
+  Name name = Name(kNdvrDvInfoPrefix);
+  name.append(m_routerPrefix);
+  name.append(kMerkleTag);
+  name.append("BUCKET");
+  name.appendNumber(std::numeric_limits<uint32_t>::max());
+  name.appendNumber(std::numeric_limits<uint32_t>::max());
+  name.appendVersion(std::numeric_limits<uint64_t>::max());
+  name.appendSegment(std::numeric_limits<uint32_t>::max());
+  ndn::Data data(name);
+  data.setFreshnessPeriod(ndn::time::milliseconds(1000));
+  data.setFinalBlock(name::Component::fromSegment(std::numeric_limits<uint32_t>::max()));
+  m_keyChain.sign(data, m_signingInfo);
+  size_t overhead = data.wireEncode().size() + kOverheadSlack;
+  if (m_dvInfoPush) {
+    Interest push = MakeDvInfoPushInterest(std::numeric_limits<uint32_t>::max(), data);
+    overhead += push.wireEncode().size() - data.wireEncode().size();
+  }
+
+  m_dvInfoSegmentSize = std::max(kMinSegmentSize, m_dvInfoMtu > overhead ? m_dvInfoMtu - overhead : 0);
+  NS_LOG_INFO("DV-Info segment size=" << m_dvInfoSegmentSize << " mtu=" << m_dvInfoMtu << " overhead=" << overhead);
+  return m_dvInfoSegmentSize;
+}
+
+void Ndvr::PruneDvInfoCache() {
+  auto now = time::steady_clock::now();
+  for (auto it = m_dvInfoCache.begin(); it != m_dvInfoCache.end(); ) {
+    if (it->second.version != m_routingTable.GetVersion() && now - it->second.lastUsed > kDvInfoCacheLifetime) {
+      NS_LOG_DEBUG("DvInfo cache entry expired: name=" << it->first << " version=" << it->second.version);
+      auto current = m_currentDvInfo.find(GetDvInfoBaseName(it->first));
+      if (current != m_currentDvInfo.end() && current->second == it->first)
+        m_currentDvInfo.erase(current);
+      it = m_dvInfoCache.erase(it);
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+/* Liveness probes (a la BFD): hellos go on the broadcast medium and take
+ * seconds to time a neighbor out. On point-to-point faces we also send
+ * small probe Interests, <neighbor prefix>/PROBE/<seq>, every
+ * m_probeInterval and remove the neighbor once m_probeDetectMult intervals
+ * go by without a reply. Replies are empty Data signed with a SHA-256 digest,
+ * so both sides stay cheap.
+ *
+ * The face probed is the neighbor's face, which is the face its first hello
+ * came from unless unicast faces are enabled (then it is the unicast face
+ * created to the neighbor's MAC address). Hellos go over the multicast
+ * faces we listen on, so without unicast faces neighbors are only probed if
+ * one of those is point-to-point; otherwise they are only timed out by
+ * their hellos */
+void Ndvr::StartProbing(const std::string& neigh) {
+  if (m_probeInterval == time::milliseconds::zero())
+    return;
+  auto neigh_it = m_neighMap.find(neigh);
+  if (neigh_it == m_neighMap.end())
+    return;
+  m_routingTable.queryFaceLinkType(neigh_it->second.GetFaceId(),
+    [this, neigh] (ndn::nfd::LinkType linkType) {
+      if (linkType != ndn::nfd::LINK_TYPE_POINT_TO_POINT)
+        return;
+      auto neigh_it = m_neighMap.find(neigh);
+      if (neigh_it == m_neighMap.end())
+        return;
+      NS_LOG_INFO("Probing neighbor=" << neigh << " interval=" << m_probeInterval << " detectMult=" << m_probeDetectMult);
+      RescheduleProbeTimeout(neigh_it->second);
+      SendProbe(neigh);
+    });
+}
+
+void Ndvr::SendProbe(const std::string& neigh) {
+  auto neigh_it = m_neighMap.find(neigh);
+  if (neigh_it == m_neighMap.end())
+    return;
+  NeighborEntry& neighbor = neigh_it->second;
+
+  Name name(neigh);
+  name.append(kProbeTag);
+  name.appendNumber(neighbor.NextProbeSeq());
+  Interest interest(name);
+  interest.setNonce(m_rand_nonce(m_rengine));
+  interest.setCanBePrefix(false);
+  interest.setMustBeFresh(true);
+  interest.setInterestLifetime(m_probeInterval * m_probeDetectMult);
+  /* straight to the neighbor's face, whatever the routes to its prefix */
+  interest.setTag(std::make_shared<lp::NextHopFaceIdTag>(neighbor.GetFaceId()));
+
+  m_face.expressInterest(interest,
+                        [this, neigh] (const Interest&, const Data&) { OnProbeReply(neigh); },
+                        [](const Interest&, const lp::Nack&) {},
+                        [](const Interest&) {});
+
+  m_timerWheel.schedule(neighbor.probe_event, m_probeInterval, [this, neigh] { SendProbe(neigh); });
+}
+
+void Ndvr::OnProbeReply(const std::string& neigh) {
+  auto neigh_it = m_neighMap.find(neigh);
+  if (neigh_it == m_neighMap.end())
+    return;
+  RescheduleProbeTimeout(neigh_it->second);
+}
+
+void Ndvr::RescheduleProbeTimeout(NeighborEntry& neighbor) {
+  const std::string neigh = neighbor.GetName();
+  m_timerWheel.schedule(neighbor.probe_timeout_event, m_probeInterval * m_probeDetectMult,
+    [this, neigh] {
+      NS_LOG_INFO("Neighbor=" << neigh << " missed " << m_probeDetectMult << " probes, removing it");
+      RemoveNeighbor(neigh);
+    });
+}
+
+void Ndvr::OnProbeInterest(const ndn::Interest& interest) {
+  auto data = std::make_shared<ndn::Data>(interest.getName());
+  data->setFreshnessPeriod(time::milliseconds(0));
+  m_keyChain.sign(*data, security::signingWithSha256());
   m_face.put(*data);
 }
 
@@ -690,46 +1040,510 @@ void Ndvr::OnKeyInterest(const ndn::Interest& interest) {
   }
 }
 
-void Ndvr::OnDvInfoTimedOut(const ndn::Interest& interest, uint32_t retx) {
-  // TODO: Apply the same logic as in HelloProtocol::processInterestTimedOut (~/mini-ndn/ndn-src/NLSR/src/hello-protocol.cpp)
-  // TODO: what if node has moved?
-  NS_LOG_DEBUG("Interest timed out for Name: " << interest.getName()<< " retx=" << retx);
-  return;
+/* Push mode: a change is pushed to the neighbors right away as the signed
+ * delta since the previous push, instead of waiting for them to learn the
+ * new version from a hello and ask for it after a backoff. NFD does not
+ * forward unsolicited Data (the localhop policy just caches it), so the
+ * DvInfo Data travels inside a multicast Interest. Changes within
+ * kDvInfoPushDelay are pushed together */
+void Ndvr::SchedDvInfoPush() {
+  if (!m_dvInfoPush || dvinfopush_event)
+    return;
+  dvinfopush_event = m_scheduler.schedule(kDvInfoPushDelay, [this] { SendDvInfoPush(); });
+}
 
-  /* what is the maximum retransmission? Just 1?*/
-  if (retx > 1)
+void Ndvr::SendDvInfoPush() {
+  uint32_t version = m_routingTable.GetVersion();
+  uint32_t since = m_lastPushedVersion;
+  m_lastPushedVersion = version;
+  if (since == 0 || since == version || m_neighMap.empty())
     return;
 
-  /* Sanity checks */
-  std::string neighPrefix = ExtractRouterPrefix(interest.getName(), kNdvrDvInfoPrefix);
-  if (!isValidRouter(interest.getName(), kNdvrDvInfoPrefix) || neighPrefix == m_routerPrefix) {
+  Name dvInfoName = Name(kNdvrDvInfoPrefix);
+  dvInfoName.append(m_routerPrefix);
+  dvInfoName.appendNumber(version);
+  dvInfoName.appendNumber(since);
+  /* the pushed Data is the same neighbors would pull, so the ones that
+   * missed it get it from the cache */
+  const auto& segments = GetCurrentDvInfoSegments(dvInfoName).segments;
+  if (segments.size() != 1) {
+    NS_LOG_INFO("DV-Info too large to be pushed, neighbors will pull it: name=" << dvInfoName << " segments=" << segments.size());
+    return;
+  }
+
+  Interest interest = MakeDvInfoPushInterest(version, *segments[0]);
+  /* the segment size leaves room for the Interest, unless the signature
+   * (or the MTU) changed since it was measured */
+  if (interest.wireEncode().size() > m_dvInfoMtu) {
+    NS_LOG_INFO("DV-Info push over the MTU, neighbors will pull it: name=" << dvInfoName << " size=" << interest.wireEncode().size() << " mtu=" << m_dvInfoMtu);
+    return;
+  }
+  NS_LOG_INFO("Pushing DV-Info " << dvInfoName);
+
+  m_face.expressInterest(interest, [](const Interest&, const Data&) {},
+                        [](const Interest&, const lp::Nack&) {},
+                        [](const Interest&) {});
+}
+
+/* a push of @p segment, the single segment DvInfo of @p version */
+Interest Ndvr::MakeDvInfoPushInterest(uint32_t version, const ndn::Data& segment) {
+  Name name = Name(kNdvrDvPushPrefix);
+  name.append(m_routerPrefix);
+  name.appendNumber(version);
+
+  Interest interest = Interest();
+  interest.setNonce(m_rand_nonce(m_rengine));
+  interest.setName(name);
+  interest.setCanBePrefix(false);
+  interest.setInterestLifetime(time::milliseconds(0));
+  interest.setApplicationParameters(segment.wireEncode());
+  return interest;
+}
+
+void Ndvr::OnDvPushInterest(const ndn::Interest& interest) {
+  NS_LOG_INFO("Received DV-Info push " << interest.getName());
+
+  std::string neighPrefix = ExtractRouterPrefix(interest.getName(), kNdvrDvPushPrefix);
+  if (!isValidRouter(interest.getName(), kNdvrDvPushPrefix) || neighPrefix == m_routerPrefix) {
+    return;
+  }
+  /* neighbors are only learned from hellos */
+  auto neigh_it = m_neighMap.find(neighPrefix);
+  if (neigh_it == m_neighMap.end() || !interest.hasApplicationParameters()) {
+    return;
+  }
+  auto& neighbor = neigh_it->second;
+
+  ndn::Data data;
+  try {
+    const Block& params = interest.getApplicationParameters();
+    params.parse();
+    data = ndn::Data(params.get(tlv::Data));
+  }
+  catch (const std::exception& e) {
+    NS_LOG_INFO("Invalid DV-Info push: " << e.what());
     return;
   }
+  const Name& dataName = data.getName();
+  if (!kNdvrDvInfoPrefix.isPrefixOf(dataName) || dataName.size() < kNdvrDvInfoPrefix.size()+6 ||
+      ExtractRouterPrefix(dataName, kNdvrDvInfoPrefix) != neighPrefix || !dataName.get(-1).isSegment() ||
+      !dataName.get(-2).isVersion()) {
+    NS_LOG_INFO("Invalid DV-Info push name=" << dataName);
+    return;
+  }
+
+  uint32_t version = ExtractVersionFromDvInfo(dataName);
+  uint32_t since = ExtractSinceVersionFromDvInfo(dataName);
+  if (version <= neighbor.GetAppliedVersion()) {
+    NS_LOG_INFO("DV-Info push already applied version=" << version << " applied=" << neighbor.GetAppliedVersion());
+    return;
+  }
+  /* the delta holds the current state of everything changed after since, so
+   * it applies on top of any version from since on. Otherwise we missed a
+   * change and fall back to pull */
+  if (since == 0 || since > neighbor.GetAppliedVersion()) {
+    NS_LOG_INFO("DV-Info push version gap since=" << since << " applied=" << neighbor.GetAppliedVersion() << ", pulling..");
+    if (version > neighbor.GetVersion())
+      neighbor.SetVersion(version);
+    SchedDvInfoInterest(neighbor);
+    return;
+  }
+
+  m_validator.validate(data,
+                       std::bind(&Ndvr::OnValidatedDvPush, this, _1),
+                       [] (const ndn::Data& data, const ndn::security::v2::ValidationError& ve) {
+                         NS_LOG_DEBUG("Not validated DV-Info push: " << data.getName() << ". The failure info: " << ve);
+                       });
+}
+
+void Ndvr::OnValidatedDvPush(const ndn::Data& data) {
+  std::string neighPrefix = ExtractRouterPrefix(data.getName(), kNdvrDvInfoPrefix);
   auto neigh_it = m_neighMap.find(neighPrefix);
   if (neigh_it == m_neighMap.end()) {
     return;
   }
-  uint32_t version = ExtractVersionFromAnnounce(interest.getName());
-  if (version < neigh_it->second.GetVersion()) {
-    /* there is a newer version, so no sense retransmite this */
+  auto& neighbor = neigh_it->second;
+
+  /* the neighbor may have changed while validating */
+  uint32_t version = ExtractVersionFromDvInfo(data.getName());
+  if (version <= neighbor.GetAppliedVersion() || ExtractSinceVersionFromDvInfo(data.getName()) > neighbor.GetAppliedVersion()) {
+    NS_LOG_INFO("DV-Info push outdated after validation name=" << data.getName());
+    return;
+  }
+  RescheduleNeighRemoval(neighbor);
+  if (version > neighbor.GetVersion())
+    neighbor.SetVersion(version);
+  /* a transfer of this version (or an older one) is no longer needed */
+  auto fetch_it = m_dvInfoFetches.find(neighPrefix);
+  if (fetch_it != m_dvInfoFetches.end() && ExtractVersionFromDvInfo(fetch_it->second.name) <= version)
+    EndDvInfoFetch(fetch_it);
+
+  const auto& content = data.getContent();
+  ApplyDvInfo(neighbor, content.value(), content.value_size());
+}
+
+/* Merkle reconciliation, producer side. Names are
+ *   <NDVR_DVINFO_PREFIX>/<router>/MERKLE/ROOT        digests of the root's children
+ *   <NDVR_DVINFO_PREFIX>/<router>/MERKLE/NODE/<i>    digests of the i-th child's buckets
+ *   <NDVR_DVINFO_PREFIX>/<router>/MERKLE/BUCKET/<b>/<encoding>/<segment>
+ *                                                    digest and entries of bucket b
+ * ROOT and NODE replies are signed once per digest of the node they list
+ * the children of. Buckets are served like DvInfo: segmented, signed once
+ * per encoding and cached, starting with an Interest for the bucket name
+ * (CanBePrefix)
+ */
+void Ndvr::ReplyMerkleInterest(const ndn::Interest& interest) {
+  const Name& name = interest.getName();
+  const MerkleDigest& merkle = m_routingTable.GetMerkleDigest();
+  size_t pos = kNdvrDvInfoPrefix.size()+4;
+  std::string kind = name.size() > pos ? name.get(pos).toUri() : "";
+  uint64_t index = name.size() > pos+1 && name.get(pos+1).isNumber() ? name.get(pos+1).toNumber() : 0;
+
+  std::string content;
+  IncrementalDigest::Bytes version;
+  if (kind == "ROOT" && name.size() == pos+1) {
+    version = merkle.root().toFixedBytes();
+  }
+  else if (kind == "NODE" && name.size() == pos+2 && index < MerkleDigest::kFanout) {
+    version = merkle.node(index).toFixedBytes();
+  }
+  else if (kind == "BUCKET" && (name.size() == pos+2 || name.size() == pos+4) &&
+           index < MerkleDigest::kBuckets && name.get(pos+1).isNumber()) {
+    return ReplyDvInfoInterest(interest);
+  }
+  else {
+    NS_LOG_INFO("Invalid Merkle Interest, ignoring.. I=" << name);
+    return;
+  }
+
+  /* the reply lists the children of a digest, so it stays the same until
+   * that digest changes */
+  auto& reply = m_merkleReplies[name];
+  if (reply.data && reply.digest == version) {
+    NS_LOG_INFO("Replying Merkle Interest from cache I=" << name);
+    m_face.put(*reply.data);
     return;
   }
 
-  /* is it worth to send a DvInfo now instead of waiting the next hello/dvinfo exchange cycle? */
-  // if (neigh_it->second.GetLastSeenDelta() >= m_helloIntervalCur -1)
-  //   return
+  if (kind == "ROOT") {
+    for (size_t i = 0; i < MerkleDigest::kFanout; i++) {
+      auto digest = merkle.node(i).toFixedBytes();
+      content.append(digest.begin(), digest.end());
+    }
+  }
+  else {
+    for (size_t b = index * MerkleDigest::kFanout; b < (index + 1) * MerkleDigest::kFanout; b++) {
+      auto digest = merkle.bucket(b).toFixedBytes();
+      content.append(digest.begin(), digest.end());
+    }
+  }
+  NS_LOG_INFO("Replying Merkle Interest I=" << name << " size=" << content.size());
+
+  auto data = std::make_shared<ndn::Data>(name);
+  /* digests change with the routing table, they must not be cached */
+  data->setFreshnessPeriod(ndn::time::milliseconds(0));
+  data->setContent(make_span(reinterpret_cast<const uint8_t*>(content.data()), content.size()));
+  m_keyChain.sign(*data, m_signingInfo);
+  data->wireEncode();
+  reply.digest = version;
+  reply.data = data;
+  m_face.put(*data);
+}
+
+/* all the entries of a bucket, i.e., a full DvInfo of a slice of the table */
+void Ndvr::EncodeDvInfoBucket(std::string& out, size_t bucket) {
+  proto::DvInfo dvinfo_proto;
+  dvinfo_proto.set_version(m_routingTable.GetVersion());
+  for (auto entry : m_routingTable.GetBucketEntries(bucket))
+    EncodeDvInfoEntry(entry->first, entry->second, dvinfo_proto.add_entry());
+  dvinfo_proto.AppendToString(&out);
+}
 
-  SchedDvInfoInterest(neigh_it->second, retx+1);
+/* Merkle reconciliation, requester side: fetch the root's children, then
+ * the children that differ from what we have, then the buckets that differ.
+ * Any failure falls back to pulling the DvInfo. With @p learnOnly, the
+ * DvInfo has just been pulled and only the leaves are fetched, to compare
+ * with next time */
+void Ndvr::StartMerkleSync(const std::string& neighbor_name, bool learnOnly) {
+  auto& sync = m_merkleSyncs[neighbor_name];
+  sync = MerkleSync();
+  sync.id = ++m_merkleSyncId;
+  sync.learnOnly = learnOnly;
+  NS_LOG_INFO("Start Merkle reconciliation with neighbor=" << neighbor_name << " id=" << sync.id << " learnOnly=" << learnOnly);
+  SendMerkleInterest(neighbor_name, sync.id, GetMerkleName(neighbor_name, Name("ROOT")));
 }
 
-void Ndvr::OnDvInfoNack(const ndn::Interest& interest, const ndn::lp::Nack& nack) {
-  NS_LOG_DEBUG("Received Nack with reason: " << nack.getReason());
-  // should we treat as a timeout? should the Nack represent no changes on neigh DvInfo?
-  //m_scheduler.schedule(ndn::time::seconds(m_localRTInterval),
-  //  [this, interest] { processInterestTimedOut(interest); });
+Name Ndvr::GetMerkleName(const std::string& neighbor_name, const Name& suffix) {
+  Name name = Name(kNdvrDvInfoPrefix);
+  name.append(neighbor_name);
+  name.append(kMerkleTag);
+  name.append(suffix);
+  return name;
 }
 
-void Ndvr::OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data) {
+void Ndvr::SendMerkleInterest(const std::string& neighbor_name, uint64_t id, const Name& name, bool canBePrefix) {
+  Interest interest = Interest();
+  interest.setNonce(m_rand_nonce(m_rengine));
+  interest.setName(name);
+  interest.setCanBePrefix(canBePrefix);
+  interest.setMustBeFresh(true);
+  auto neigh_it = m_neighMap.find(neighbor_name);
+  if (neigh_it != m_neighMap.end())
+    interest.setInterestLifetime(time::duration_cast<time::milliseconds>(neigh_it->second.dvInfoRtt.getEstimatedRto()));
+  else
+    interest.setInterestLifetime(time::seconds(m_localRTTimeout));
+
+  m_face.expressInterest(interest,
+    [this, neighbor_name, id] (const Interest&, const Data& data) {
+      m_validator.validate(data,
+        [this, neighbor_name, id] (const Data& data) { OnMerkleData(neighbor_name, id, data); },
+        [this, neighbor_name, id] (const Data& data, const ndn::security::v2::ValidationError& ve) {
+          NS_LOG_DEBUG("Not validated data: " << data.getName() << ". The failure info: " << ve);
+          AbortMerkleSync(neighbor_name, id);
+        });
+    },
+    [this, neighbor_name, id] (const Interest&, const lp::Nack&) { AbortMerkleSync(neighbor_name, id); },
+    [this, neighbor_name, id] (const Interest&) { AbortMerkleSync(neighbor_name, id); });
+}
+
+void Ndvr::AbortMerkleSync(const std::string& neighbor_name, uint64_t id) {
+  auto it = m_merkleSyncs.find(neighbor_name);
+  if (it == m_merkleSyncs.end() || it->second.id != id)
+    return;
+  bool learnOnly = it->second.learnOnly;
+  m_merkleSyncs.erase(it);
+  /* after a pull, the routes are up to date: only the leaves are missing,
+   * and the next reconciliation pulls again */
+  if (learnOnly) {
+    NS_LOG_INFO("Abort learning the Merkle leaves of neighbor=" << neighbor_name);
+    return;
+  }
+  NS_LOG_INFO("Abort Merkle reconciliation with neighbor=" << neighbor_name << ", pulling..");
+  PullDvInfo(neighbor_name);
+}
+
+/* the reconciliation is over: once the leaves add up to the announced
+ * root, we have the neighbor's table as of the version it announced */
+void Ndvr::EndMerkleSync(const std::string& neighbor_name) {
+  m_merkleSyncs.erase(neighbor_name);
+  auto neigh_it = m_neighMap.find(neighbor_name);
+  if (neigh_it == m_neighMap.end())
+    return;
+  auto& neighbor = neigh_it->second;
+  if (neighbor.IsMerkleSynced()) {
+    NS_LOG_INFO("Merkle reconciliation done with neighbor=" << neighbor_name << " version=" << neighbor.GetVersion());
+    neighbor.SetAppliedVersion(neighbor.GetVersion());
+  }
+  else {
+    NS_LOG_INFO("Merkle reconciliation done, root still differs from neighbor=" << neighbor_name);
+  }
+}
+
+void Ndvr::OnMerkleData(const std::string& neighbor_name, uint64_t id, const ndn::Data& data) {
+  auto it = m_merkleSyncs.find(neighbor_name);
+  auto neigh_it = m_neighMap.find(neighbor_name);
+  if (it == m_merkleSyncs.end() || it->second.id != id || neigh_it == m_neighMap.end())
+    return;
+  auto& sync = it->second;
+  auto& neighbor = neigh_it->second;
+  RescheduleNeighRemoval(neighbor);
+
+  const Name& name = data.getName();
+  size_t pos = kNdvrDvInfoPrefix.size()+4;
+  std::string kind = name.get(pos).toUri();
+  const Block& content = data.getContent();
+  const size_t kSize = IncrementalDigest::kSize;
+
+  if (kind == "ROOT") {
+    if (content.value_size() != MerkleDigest::kFanout * kSize)
+      return AbortMerkleSync(neighbor_name, id);
+    for (size_t i = 0; i < MerkleDigest::kFanout; i++) {
+      if (std::memcmp(content.value() + i * kSize, neighbor.GetMerkleNode(i).data(), kSize) == 0)
+        continue;
+      sync.pendingNodes++;
+      SendMerkleInterest(neighbor_name, id, GetMerkleName(neighbor_name, Name("NODE").appendNumber(i)));
+    }
+    if (sync.pendingNodes == 0)
+      EndMerkleSync(neighbor_name);
+    return;
+  }
+
+  if (kind == "NODE") {
+    uint64_t i = name.get(pos+1).toNumber();
+    if (i >= MerkleDigest::kFanout || content.value_size() != MerkleDigest::kFanout * kSize)
+      return AbortMerkleSync(neighbor_name, id);
+    for (size_t j = 0; j < MerkleDigest::kFanout; j++) {
+      size_t b = i * MerkleDigest::kFanout + j;
+      IncrementalDigest::Bytes leaf;
+      std::copy(content.value() + j * kSize, content.value() + (j + 1) * kSize, leaf.begin());
+      if (leaf != neighbor.GetMerkleLeaf(b))
+        sync.leaves.emplace_back(b, leaf);
+    }
+    if (--sync.pendingNodes > 0)
+      return;
+
+    NS_LOG_INFO("Merkle reconciliation with neighbor=" << neighbor_name << " buckets=" << sync.leaves.size());
+    if (sync.learnOnly) {
+      for (auto& leaf : sync.leaves)
+        neighbor.SetMerkleLeaf(leaf.first, leaf.second);
+      m_merkleSyncs.erase(it);
+      /* the leaves are only good if they are those of the DvInfo applied */
+      if (neighbor.GetAppliedVersion() != neighbor.GetVersion() || !neighbor.IsMerkleSynced()) {
+        NS_LOG_INFO("Merkle leaves of neighbor=" << neighbor_name << " are not those of version=" << neighbor.GetAppliedVersion());
+        neighbor.ClearMerkleLeaves();
+      }
+      return;
+    }
+    if (!neighbor.HasMerkleLeaves() || sync.leaves.size() > kMerkleMaxBuckets) {
+      /* the leaves are fetched before the DvInfo, so they are never newer
+       * than the routes we get */
+      neighbor.pendingMerkleLeaves = std::move(sync.leaves);
+      m_merkleSyncs.erase(it);
+      PullDvInfo(neighbor_name);
+      return;
+    }
+    for (auto& leaf : sync.leaves) {
+      sync.buckets[leaf.first].name = GetMerkleName(neighbor_name, Name("BUCKET").appendNumber(leaf.first));
+      SendMerkleInterest(neighbor_name, id, sync.buckets[leaf.first].name, true);
+    }
+    if (sync.buckets.empty())
+      EndMerkleSync(neighbor_name);
+    return;
+  }
+
+  if (kind != "BUCKET" || name.size() != pos+4 || !name.get(pos+1).isNumber() ||
+      !name.get(-1).isSegment() || !name.get(-2).isVersion())
+    return AbortMerkleSync(neighbor_name, id);
+  uint64_t b = name.get(pos+1).toNumber();
+  auto fetch_it = sync.buckets.find(b);
+  if (fetch_it == sync.buckets.end())
+    return AbortMerkleSync(neighbor_name, id);
+  auto& fetch = fetch_it->second;
+  Name encodedName = name.getPrefix(-1);
+  uint64_t segment = name.get(-1).toSegment();
+  if (fetch.encodedName.empty()) {
+    /* segment 0 tells the encoding, the other segments are asked for by its
+     * name so that they all come from the same one */
+    const auto& finalBlock = data.getFinalBlock();
+    if (segment != 0 || !finalBlock || !finalBlock->isSegment())
+      return AbortMerkleSync(neighbor_name, id);
+    fetch.encodedName = encodedName;
+    fetch.nSegments = finalBlock->toSegment() + 1;
+    fetch.nextSegment = 1;
+    fetch.segments.resize(fetch.nSegments);
+    fetch.received.resize(fetch.nSegments);
+  }
+  else {
+    fetch.nInFlight--;
+    if (encodedName != fetch.encodedName || segment >= fetch.nSegments)
+      return AbortMerkleSync(neighbor_name, id);
+  }
+  if (!fetch.received[segment]) {
+    fetch.received[segment] = true;
+    fetch.segments[segment] = content;
+    fetch.nReceived++;
+  }
+  if (fetch.nReceived < fetch.nSegments) {
+    while (fetch.nInFlight < kDvInfoWindow && fetch.nextSegment < fetch.nSegments) {
+      fetch.nInFlight++;
+      SendMerkleInterest(neighbor_name, id, Name(fetch.encodedName).appendSegment(fetch.nextSegment++));
+    }
+    return;
+  }
+
+  std::string bucket;
+  for (auto& block : fetch.segments)
+    bucket.append(reinterpret_cast<const char*>(block.value()), block.value_size());
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(bucket.data());
+  if (bucket.size() < kSize || !ApplyMerkleBucket(neighbor, b, buf + kSize, bucket.size() - kSize))
+    return AbortMerkleSync(neighbor_name, id);
+  /* the digest comes with the entries, so they always match */
+  IncrementalDigest::Bytes leaf;
+  std::copy(buf, buf + kSize, leaf.begin());
+  neighbor.SetMerkleLeaf(b, leaf);
+  sync.buckets.erase(fetch_it);
+  if (sync.buckets.empty())
+    EndMerkleSync(neighbor_name);
+}
+
+/* A bucket is the whole state of a slice of the neighbor's table: its
+ * entries are processed as usual, and the routes we have via the neighbor
+ * in that bucket but it no longer has are withdrawn */
+bool Ndvr::ApplyMerkleBucket(NeighborEntry& neighbor, size_t bucket, const uint8_t* buf, size_t size) {
+  proto::DvInfo dvinfo_proto;
+  if (!dvinfo_proto.ParseFromArray(buf, size)) {
+    NS_LOG_INFO("Invalid Merkle bucket from neighbor=" << neighbor.GetName());
+    return false;
+  }
+  bool has_changed = false;
+  std::set<std::string> present;
+  for (const auto& entry : dvinfo_proto.entry()) {
+    if (MerkleDigest::bucketOf(entry.prefix()) != bucket)
+      continue;
+    present.insert(entry.prefix());
+    if (processDvInfoEntry(neighbor, entry))
+      has_changed = true;
+  }
+  std::vector<std::string> withdrawn;
+  for (auto entry : m_routingTable.GetBucketEntries(bucket)) {
+    RoutingEntry& re = entry->second;
+    if (!re.isDirectRoute() && re.isNextHop(neighbor.GetFaceId()) &&
+        re.GetNextHopName(neighbor.GetFaceId()) == neighbor.GetName() && present.count(entry->first) == 0)
+      withdrawn.push_back(entry->first);
+  }
+  for (auto& prefix : withdrawn) {
+    if (processDvInfoWithdrawn(neighbor, prefix))
+      has_changed = true;
+  }
+  NS_LOG_INFO("Merkle bucket=" << bucket << " from neighbor=" << neighbor.GetName() << " entries=" << present.size() << " withdrawn=" << withdrawn.size());
+
+  if (has_changed) {
+    m_routingTable.IncVersion();
+    /* notify neighbors about a new DvInfo within the minimum hello interval */
+    m_helloTrickle.Reset();
+    SchedDvInfoPush();
+  }
+  return true;
+}
+
+void Ndvr::OnDvInfoTimedOut(const ndn::Interest& interest, uint32_t retx) {
+  // TODO: what if node has moved?
+  NS_LOG_DEBUG("Interest timed out for Name: " << interest.getName()<< " retx=" << retx);
+
+  auto fetch_it = FindDvInfoFetch(interest.getName());
+  if (fetch_it == m_dvInfoFetches.end())
+    return;
+  auto& fetch = fetch_it->second;
+  fetch.nInFlight--;
+
+  /* only the missing segment is retransmitted, unless there is a newer
+   * version (then the hello processing schedules a new transfer) */
+  auto neigh_it = m_neighMap.find(fetch_it->first);
+  if (retx >= kDvInfoSegmentRetries || neigh_it == m_neighMap.end() ||
+      ExtractVersionFromDvInfo(fetch.name) < neigh_it->second.GetVersion()) {
+    NS_LOG_INFO("Abandon DV-Info transfer name=" << fetch.name << " received=" << fetch.nReceived << "/" << fetch.nSegments);
+    EndDvInfoFetch(fetch_it);
+    return;
+  }
+  SendDvInfoSegment(neigh_it->second, fetch, GetDvInfoSegment(interest.getName()), retx+1);
+}
+
+void Ndvr::OnDvInfoNack(const ndn::Interest& interest, const ndn::lp::Nack& nack, uint32_t retx) {
+  NS_LOG_DEBUG("Received Nack with reason: " << nack.getReason() << " for Name: " << interest.getName() << " retx=" << retx);
+
+  auto fetch_it = FindDvInfoFetch(interest.getName());
+  if (fetch_it == m_dvInfoFetches.end())
+    return;
+  auto& fetch = fetch_it->second;
+  fetch.nInFlight--;
+
+  /* the transfer can not complete, the next hello schedules a new one */
+  NS_LOG_INFO("Abandon DV-Info transfer name=" << fetch.name << " received=" << fetch.nReceived << "/" << fetch.nSegments);
+  EndDvInfoFetch(fetch_it);
+}
+
+void Ndvr::OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data, uint32_t retx,
+                           time::steady_clock::TimePoint sentAt) {
   NS_LOG_DEBUG("Received content for DV-Info: " << data.getName());
 
   /* Sanity checks */
@@ -743,6 +1557,11 @@ void Ndvr::OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data)
     return;
   }
 
+  /* RTT sample, unless the Interest was retransmitted (Karn's algorithm) */
+  auto neigh_it = m_neighMap.find(neighPrefix);
+  if (retx == 0 && neigh_it != m_neighMap.end())
+    neigh_it->second.dvInfoRtt.addMeasurement(time::steady_clock::now() - sentAt);
+
   /* Security validation */
   if (data.getSignatureInfo().hasKeyLocator()) {
     NS_LOG_DEBUG("Data signed with: " << data.getSignatureInfo().getKeyLocator().getName());
@@ -756,7 +1575,7 @@ void Ndvr::OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data)
 }
 
 void Ndvr::OnValidatedDvInfo(const ndn::Data& data) {
-  NS_LOG_DEBUG("Validated data: " << data.getName());
+  NS_LOG_DEBUG("Validated data: " << data.getName() << " digestHits=" << m_validator.GetDigestHits() << " certificateHits=" << m_validator.GetCertificateHits() << " fullValidations=" << m_validator.GetFullValidations());
   std::string neighPrefix = ExtractRouterPrefix(data.getName(), kNdvrDvInfoPrefix);
 
   /* Sanity check: at this point the neighbor should be known */
@@ -769,281 +1588,392 @@ void Ndvr::OnValidatedDvInfo(const ndn::Data& data) {
   /* Update lastSeen and reschedule neighbor removal */
   RescheduleNeighRemoval(neigh_it->second);
 
+  auto fetch_it = FindDvInfoFetch(data.getName());
+  if (fetch_it == m_dvInfoFetches.end()) {
+    NS_LOG_INFO("DvInfo segment of no ongoing transfer, ignoring.. name=" << data.getName());
+    return;
+  }
+  auto& fetch = fetch_it->second;
+  if (fetch.nInFlight > 0)
+    fetch.nInFlight--;
+
+  Name encodedName = data.getName().getPrefix(-1);
+  if (!data.getName().get(-1).isSegment() || encodedName.empty() || !encodedName.get(-1).isVersion() ||
+      (!fetch.encodedName.empty() && encodedName != fetch.encodedName)) {
+    NS_LOG_INFO("DvInfo segment of another encoding!!! Abort transfer.. name=" << data.getName());
+    EndDvInfoFetch(fetch_it);
+    return;
+  }
+  fetch.encodedName = encodedName;
+
+  const auto& finalBlock = data.getFinalBlock();
+  if (!finalBlock || !finalBlock->isSegment() ||
+      (fetch.nSegments > 0 && finalBlock->toSegment() + 1 != fetch.nSegments)) {
+    NS_LOG_INFO("Invalid DvInfo FinalBlockId!!! Abort transfer.. name=" << data.getName());
+    EndDvInfoFetch(fetch_it);
+    return;
+  }
+  if (fetch.nSegments == 0) {
+    fetch.nSegments = finalBlock->toSegment() + 1;
+    fetch.segments.resize(fetch.nSegments);
+    fetch.received.resize(fetch.nSegments);
+  }
+  uint64_t segment = data.getName().get(-1).toSegment();
+  if (segment >= fetch.nSegments) {
+    NS_LOG_INFO("DvInfo segment out of range!!! Abort transfer.. name=" << data.getName());
+    EndDvInfoFetch(fetch_it);
+    return;
+  }
+  if (!fetch.received[segment]) {
+    fetch.received[segment] = true;
+    fetch.segments[segment] = data.getContent();
+    fetch.nReceived++;
+  }
+
+  if (fetch.nReceived < fetch.nSegments) {
+    /* keep the window of segments full */
+    while (fetch.nInFlight < kDvInfoWindow && fetch.nextSegment < fetch.nSegments)
+      SendDvInfoSegment(neigh_it->second, fetch, fetch.nextSegment++);
+    return;
+  }
+
   /* Extract DvInfo and process Distance Vector update */
-  const auto& content = data.getContent();
-  proto::DvInfo dvinfo_proto;
-  //NS_LOG_DEBUG("Content: size=" << content.value_size());
-  //NS_LOG_INFO("Trying to parser  DV-Info...");
-  if (!dvinfo_proto.ParseFromArray(content.value(), content.value_size())) {
+  DvInfoFetch done = std::move(fetch);
+  EndDvInfoFetch(fetch_it);
+  std::string reassembled;
+  const uint8_t* buf = done.segments[0].value();
+  size_t size = done.segments[0].value_size();
+  if (done.nSegments > 1) {
+    for (auto& block : done.segments)
+      reassembled.append(reinterpret_cast<const char*>(block.value()), block.value_size());
+    buf = reinterpret_cast<const uint8_t*>(reassembled.data());
+    size = reassembled.size();
+  }
+  /* Merkle leaves learned before pulling are recorded with the DvInfo */
+  auto leaves = std::move(neigh_it->second.pendingMerkleLeaves);
+  neigh_it->second.pendingMerkleLeaves.clear();
+  ApplyDvInfo(neigh_it->second, buf, size, [this, leaves] (NeighborEntry& neighbor) {
+    for (auto& leaf : leaves)
+      neighbor.SetMerkleLeaf(leaf.first, leaf.second);
+    /* first pull from a neighbor: learn its leaves to reconcile next time */
+    if (m_merkleSync && (neighbor.GetHelloFlags() & HelloParams::FLAG_MERKLE) && !neighbor.HasMerkleLeaves())
+      StartMerkleSync(neighbor.GetName(), true);
+  });
+}
+
+/* Decodes and processes a complete (reassembled or pushed) DvInfo, then
+ * calls onApplied if it was valid. With worker threads, the decoding
+ * (decompression and protobuf parsing) runs on a worker and the DvInfo is
+ * applied afterwards on the main thread, in order with the other DvInfo of
+ * the neighbor. Otherwise it is decoded and applied as it is read */
+void Ndvr::ApplyDvInfo(NeighborEntry& neighbor, const uint8_t* buf, size_t size,
+                       const std::function<void(NeighborEntry&)>& onApplied) {
+  if (m_workers != nullptr) {
+    std::string neighbor_name = neighbor.GetName();
+    auto encoded = std::make_shared<std::string>(reinterpret_cast<const char*>(buf), size);
+    m_workers->submit(neighbor_name, [this, neighbor_name, encoded, onApplied] () -> WorkerPool::Completion {
+      auto dvinfo = std::make_shared<proto::DvInfo>();
+      bool ok = DecodeDvInfo(*encoded, *dvinfo);
+      return [this, neighbor_name, dvinfo, ok, onApplied] {
+        auto neigh_it = m_neighMap.find(neighbor_name);
+        if (neigh_it == m_neighMap.end())
+          return;
+        auto& neighbor = neigh_it->second;
+        if (!ok) {
+          NS_LOG_INFO("Invalid DvInfo content!!! Abort processing..");
+          return;
+        }
+        if (dvinfo->version() > 0 && dvinfo->version() <= neighbor.GetAppliedVersion()) {
+          NS_LOG_INFO("DV-Info version=" << dvinfo->version() << " already applied from neighbor=" << neighbor_name);
+          return;
+        }
+        processDecodedDvInfo(neighbor, *dvinfo);
+        if (dvinfo->version() > 0)
+          neighbor.SetAppliedVersion(dvinfo->version());
+        if (onApplied)
+          onApplied(neighbor);
+      };
+    });
+    return;
+  }
+
+  /* compact DvInfo is read as it is decoded too (see DvInfoCodec::Read) */
+  uint32_t version = 0;
+  if (!processDvInfoFromNeighbor(neighbor, buf, size, version)) {
+    /* entries applied before the decoding error are kept (the Data was
+     * already validated), but our state no longer matches any version of
+     * the neighbor, so the next request asks for the full DvInfo */
     NS_LOG_INFO("Invalid DvInfo content!!! Abort processing..");
+    neighbor.SetAppliedVersion(0);
     return;
   }
-  //NS_LOG_INFO("Parser complete! dvinfo_proto content is:");
-  //for (int i = 0; i < dvinfo_proto.entry_size(); ++i) {
-  //  const auto& entry = dvinfo_proto.entry(i);
-  //  NS_LOG_INFO("DV-Info from neighbor prefix=" << entry.prefix() << " seqNum=" << entry.seq() << " cost=" << entry.cost());
-  //}
-  //NS_LOG_INFO("Decoding...");
-  auto otherRT = DecodeDvInfo(dvinfo_proto);
-  processDvInfoFromNeighbor(neigh_it->second, otherRT);
-  //NS_LOG_INFO("Done");
+  if (version > 0)
+    neighbor.SetAppliedVersion(version);
+  if (onApplied)
+    onApplied(neighbor);
+}
+
+/* runs on the worker threads: only uses its arguments */
+bool Ndvr::DecodeDvInfo(const std::string& encoded, proto::DvInfo& dvinfo) {
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(encoded.data());
+  if (DvInfoCodec::IsCompressed(buf, encoded.size()))
+    return DvInfoCodec::Decompress(buf, encoded.size(), dvinfo);
+  return dvinfo.ParseFromString(encoded);
+}
+
+void Ndvr::SetWorkerThreads(size_t n) {
+  m_validator.SetWorkerPool(nullptr);
+  m_workers.reset();
+  if (n > 0)
+    m_workers.reset(new WorkerPool(m_face.getIoService(), n));
+  m_validator.SetWorkerPool(m_workers.get());
 }
 
 void Ndvr::OnDvInfoValidationFailed(const ndn::Data& data, const ndn::security::v2::ValidationError& ve) {
   NS_LOG_DEBUG("Not validated data: " << data.getName() << ". The failure info: " << ve);
+  auto fetch_it = FindDvInfoFetch(data.getName());
+  if (fetch_it != m_dvInfoFetches.end())
+    EndDvInfoFetch(fetch_it);
 }
 
 void Ndvr::UpdateRoutingTableDigest() {
-  proto::DvInfo to_calc_digest;
-  std::string str_digest;
-  for (auto it = m_routingTable.begin(); it != m_routingTable.end(); ++it) {
-    auto* e2 = to_calc_digest.add_entry();
-    e2->set_prefix(it->first);
-    e2->set_seq(it->second.GetSeqNum());
-    //e2->set_cost(0);
-  }
-  to_calc_digest.AppendToString(&str_digest);
-  boost::uuids::detail::sha1 sha1;
-  unsigned int hash[5];
-  sha1.process_bytes(str_digest.c_str(), str_digest.size());
-  sha1.get_digest(hash);
-  std::stringstream stream;
-  for(std::size_t i=0; i<sizeof(hash)/sizeof(hash[0]); ++i) {
-      stream << std::hex << hash[i];
-  }
-  std::string res = stream.str();
-  NS_LOG_DEBUG("RoutingTable_digest: " << res);
-  m_routingTable.SetDigest(res);
-}
-
-void Ndvr::EncodeDvInfo(std::string& out) {
+  /* the digest is kept up to date by the RoutingManager, here we only force
+   * a full rebuild */
+  m_routingTable.UpdateDigest();
+  NS_LOG_DEBUG("RoutingTable_digest: " << m_routingTable.GetDigest());
+}
+
+/* Compact DvInfo is cached and shared by all neighbors, so it is only used
+ * when all of them announce they accept it */
+bool Ndvr::UseCompactDvInfo() {
+  if (!m_compactDvInfo || m_neighMap.empty())
+    return false;
+  for (auto& n : m_neighMap)
+    if (!(n.second.GetHelloFlags() & HelloParams::FLAG_COMPACT_DVINFO))
+      return false;
+  return true;
+}
+
+void Ndvr::EncodeDvInfo(std::string& out, uint32_t sinceVersion, bool compact) {
   
   printRoutingTable();
 
   proto::DvInfo dvinfo_proto;
-  std::string routerPrefix_Uri = m_routerPrefix.toUri();
-  
-  for (auto it = m_routingTable.begin(); it != m_routingTable.end(); ++it) {
-    
-    auto* entry = dvinfo_proto.add_entry();
-    entry->set_prefix(it->first);
-    entry->set_seq(it->second.GetSeqNum());
-    //entry->set_cost(it->second.GetBestCost());
-    entry->set_originator(it->second.GetOriginator());
-    //entry->set_bestnexthop(it->second.GetLearnedFrom());
-    //entry->set_sec_cost(it->second.GetSecondBestCost());
-
-    NextHop nextHop = it->second.GetNextHops2();
-    proto::DvInfo_NextHop *next_hop = new proto::DvInfo_NextHop();
-    //next_hop->set_cost(it->second.GetCost());
-
-    for (std::string router_id: nextHop.GetRouterIds()) {
-      next_hop->add_router_id(router_id);
+  dvinfo_proto.set_version(m_routingTable.GetVersion());
+
+  /* Neighbors tell us the last version they have applied, so we send only
+   * what changed since then, unless the change log was already truncated */
+  std::vector<std::string> changes;
+  if (sinceVersion > 0 && m_routingTable.GetChangesSince(sinceVersion, changes)) {
+    dvinfo_proto.set_is_delta(true);
+    for (auto& prefix : changes) {
+      auto re = m_routingTable.LookupRoute(prefix);
+      if (re == nullptr)
+        dvinfo_proto.add_withdrawn(prefix);
+      else
+        EncodeDvInfoEntry(prefix, *re, dvinfo_proto.add_entry());
+    }
+  } else {
+    for (auto it = m_routingTable.begin(); it != m_routingTable.end(); ++it) {
+      EncodeDvInfoEntry(it->first, it->second, dvinfo_proto.add_entry());
     }
-
-    next_hop->add_router_id(routerPrefix_Uri);
-
-    entry->set_allocated_next_hops(next_hop);
-
   }
-  dvinfo_proto.AppendToString(&out);
-  NS_LOG_INFO("String DVInfo" << out);
+  if (compact) {
+    DvInfoCodec::Compress(dvinfo_proto, out);
+    NS_LOG_INFO("Compact DvInfo bytes=" << out.size() << " protobufBytes=" << dvinfo_proto.ByteSizeLong());
+  }
+  else {
+    dvinfo_proto.AppendToString(&out);
+  }
+  NS_LOG_INFO("Encoded DvInfo version=" << dvinfo_proto.version() << " since=" << sinceVersion << " delta=" << dvinfo_proto.is_delta() << " entries=" << dvinfo_proto.entry_size() << " withdrawn=" << dvinfo_proto.withdrawn_size() << " compact=" << compact);
 }
 
-void
-Ndvr::processDvInfoFromNeighbor(NeighborEntry& neighbor, RoutingTable& otherRT) {
-  NS_LOG_INFO("Process DvInfo from neighbor=" << neighbor.GetName());
-  
-  bool has_changed = false;
-  std::string routerPrefix_Uri = m_routerPrefix.toUri();
-
-  for (auto entry : otherRT) {
-    std::string neigh_prefix = entry.first;
-    uint64_t neigh_seq = entry.second.GetSeqNum();
-    uint32_t neigh_cost = entry.second.GetNextHops2().GetRouterIds().size();
-    //NS_LOG_INFO("DEBUG DE SOCORRO Custo da entrada em processDvInfoFromNeighbor " << neigh_cost);
-    
-    NS_LOG_INFO("===>> prefix=" << neigh_prefix << " seqNum=" << neigh_seq << " recvCost=" << neigh_cost << " learnedFrom=" << entry.second.GetLearnedFrom());
-
-    
-    /*for (std::string nextHop: entry.second.GetNextHops2().GetRouterIds()){
-      if (nextHop.compare(routerPrefix_Uri) == 0){
-        NS_LOG_DEBUG("===>> processDvInfoFromNeighbor => my prefix ( " << routerPrefix_Uri << " ) was found in next hops list << " << entry.second.GetName() << ".Ignoring it!");
-        //std::cout << "### >> prefix     :" << routerPrefix_Uri << std::endl;
-        NS_LOG_DEBUG("===>> prefix     : " << routerPrefix_Uri)
-        neigh_cost=100;
-        has_changed=true;
-      }
+void Ndvr::EncodeDvInfoEntry(const std::string& prefix, RoutingEntry& re, proto::DvInfo_Entry* entry) {
+  entry->set_prefix(prefix);
+  entry->set_seq(re.GetSeqNum());
+  //entry->set_cost(re.GetBestCost());
+  entry->set_originator(re.GetOriginator());
+  //entry->set_bestnexthop(re.GetLearnedFrom());
+  //entry->set_sec_cost(re.GetSecondBestCost());
+
+  /* path vectors are kept as router ids, names are only used on the wire */
+  const RouterIdTable& routerIds = RouterIdTable::instance();
+  proto::DvInfo_NextHop *next_hop = new proto::DvInfo_NextHop();
+  //next_hop->set_cost(re.GetCost());
+
+  for (auto router_id : re.GetNextHops2().GetRouterIds()) {
+    next_hop->add_router_id(routerIds.lookup(router_id));
+  }
 
-      //if (!isValidCost(neigh_cost)){
-        //continue;
-       //}
+  next_hop->add_router_id(routerIds.lookup(m_routerId));
+  next_hop->set_signature(re.GetNextHops2().GetSignature() | routerIds.mask(m_routerId));
 
-       entry.second.GetNextHops2().AddRouterId(routerPrefix_Uri);
+  entry->set_allocated_next_hops(next_hop);
+}
 
-    }*/
-    std::vector<std::string> nextHops = entry.second.GetNextHops2().GetRouterIds();
+/* The DvInfo is applied straight from its wire encoding: entries are
+ * decoded one at a time (see DvInfoCodec::Read) and applied against the
+ * local routing table as they come, without building an intermediate
+ * RoutingTable. */
+bool
+Ndvr::processDvInfoFromNeighbor(NeighborEntry& neighbor, const uint8_t* buf, size_t size, uint32_t& version) {
+  NS_LOG_INFO("Process DvInfo from neighbor=" << neighbor.GetName());
 
-    if (std::find(nextHops.begin(), nextHops.end(), routerPrefix_Uri) != nextHops.end()){
-      NS_LOG_DEBUG("===>> processDvInfoFromNeighbor => my prefix ( " << routerPrefix_Uri << " ) was found in next hops list << " << entry.second.GetName() << ".Ignoring it!");
-        //*std::cout << "### >> prefix     :" << routerPrefix_Uri << std::endl;
-      NS_LOG_DEBUG("===>> prefix     : " << routerPrefix_Uri)
-      neigh_cost=100;
-      entry.second.GetNextHops2().GetRouterIds().clear();
-      has_changed=true;
-      //SendHelloInterest();
-    }
-    /* Sanity checks: 1) ignore invalid seqNum; 2) ignore invalid Cost */
-    if (neigh_seq <= 0 || !isValidCost(neigh_cost))
-      continue;
+  bool has_changed = false;
+  bool is_delta = false;
+  size_t n_entries = 0;
+  size_t n_withdrawn = 0;
+  bool ok = DvInfoCodec::Read(buf, size,
+      [&] (const proto::DvInfo_Entry& entry) {
+        if (processDvInfoEntry(neighbor, entry))
+          has_changed = true;
+        n_entries++;
+      },
+      [&] (const std::string& prefix) {
+        if (processDvInfoWithdrawn(neighbor, prefix))
+          has_changed = true;
+        n_withdrawn++;
+      },
+      version, is_delta);
+  NS_LOG_INFO("DvInfo from neighbor=" << neighbor.GetName() << " version=" << version << " delta=" << is_delta << " entries=" << n_entries << " withdrawn=" << n_withdrawn << " ok=" << ok);
 
-    /* insert new prefix */
-    auto localRE = m_routingTable.LookupRoute(neigh_prefix);
-    if (localRE == nullptr) {
-      if (isInfinityCost(neigh_cost))
-        continue;
-      NS_LOG_INFO("======>> New prefix! Just insert it " << neigh_prefix << " via " << neighbor.GetFaceId());
-      //entry.second.SetCost(CalculateCostToNeigh(neighbor, neigh_cost));
-      //entry.second.SetFaceId(neighbor.GetFaceId());
-      //entry.second.SetLearnedFrom(neighbor.GetName());
-      m_routingTable.UpsertNextHop(entry.second, neighbor.GetFaceId(), CalculateCostToNeigh(neighbor, neigh_cost), neighbor.GetName());
+  if (has_changed) {
+    m_routingTable.IncVersion();
+    //UpdateRoutingTableDigest();
+    /* notify neighbors about a new DvInfo within the minimum hello interval */
+    m_helloTrickle.Reset();
+    SchedDvInfoPush();
+  }
+  return ok;
+}
 
+/* Applies a DvInfo decoded by a worker (see ApplyDvInfo) */
+void
+Ndvr::processDecodedDvInfo(NeighborEntry& neighbor, const proto::DvInfo& dvinfo) {
+  bool has_changed = false;
+  for (const auto& entry : dvinfo.entry())
+    if (processDvInfoEntry(neighbor, entry))
       has_changed = true;
-      continue;
-    }
+  for (const auto& prefix : dvinfo.withdrawn())
+    if (processDvInfoWithdrawn(neighbor, prefix))
+      has_changed = true;
+  NS_LOG_INFO("DvInfo from neighbor=" << neighbor.GetName() << " version=" << dvinfo.version() << " delta=" << dvinfo.is_delta() << " entries=" << dvinfo.entry_size() << " withdrawn=" << dvinfo.withdrawn_size());
 
-    /* Direct routes with higher sequence number means we should update ours */
-     if (localRE->isDirectRoute()) {
-       if (localRE->GetOriginator() == m_routerPrefix && neigh_seq > localRE->GetSeqNum()) {
-         localRE->IncSeqNum(2);
-         has_changed = true;
-       }
-       continue;
-     }
-
-    /* insert new next hop unless it was learned only from us */
-    if (!localRE->isNextHop(neighbor.GetFaceId())) {
-      if (isInfinityCost(neigh_cost))
-        continue;
-       if (entry.second.GetLearnedFrom() == m_routerPrefix) {
-         if (isInfinityCost(neigh_cost))
-            continue;
-         //neigh_cost = neigh_sec_cost;
-       }
+  if (has_changed) {
+    m_routingTable.IncVersion();
+    /* notify neighbors about a new DvInfo within the minimum hello interval */
+    m_helloTrickle.Reset();
+    SchedDvInfoPush();
+  }
+}
 
-      NS_LOG_INFO("======>> New neighbor! Just insert it " << neigh_prefix << " via " << neighbor.GetFaceId());
+/* prefix the neighbor no longer has: remove it as a next hop */
+bool
+Ndvr::processDvInfoWithdrawn(NeighborEntry& neighbor, const std::string& prefix) {
+  auto localRE = m_routingTable.LookupRoute(prefix);
+  if (localRE == nullptr || localRE->isDirectRoute() || !localRE->isNextHop(neighbor.GetFaceId()))
+    return false;
+  NS_LOG_INFO("======>> Withdrawn by neighbor! Remove nextHop for name prefix " << prefix << " nextHop=" << neighbor.GetFaceId());
+  m_routingTable.DeleteNextHop(*localRE, neighbor.GetFaceId());
+  return true;
+}
 
-      // Learned from multiple next hop, so we can unset this var      
-      //localRE->SetLearnedFrom("");
-      //localRE->SetLearnedFrom(localRE->GetNextHopName(localRE->GetBestFaceId()));
+bool
+Ndvr::processDvInfoEntry(NeighborEntry& neighbor, const proto::DvInfo_Entry& entry) {
+  const std::string& routerPrefix_Uri = RouterIdTable::instance().lookup(m_routerId);
+  const std::string& neigh_prefix = entry.prefix();
+  uint64_t neigh_seq = entry.seq();
+  const auto& neigh_path = entry.next_hops().router_id();
+  uint32_t neigh_cost = neigh_path.size();
+  bool has_changed = false;
 
-      m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), CalculateCostToNeigh(neighbor, neigh_cost), neighbor.GetName());
+  NS_LOG_INFO("===>> prefix=" << neigh_prefix << " seqNum=" << neigh_seq << " recvCost=" << neigh_cost);
+
+  /* loop detection: the exact check is only needed when the path signature
+   * has all the bits of our mask (or when the neighbor did not send it) */
+  RouterIdTable::Signature signature = entry.next_hops().signature();
+  RouterIdTable::Signature ourMask = RouterIdTable::instance().mask(m_routerId);
+  bool maybeInPath = signature == 0 || (signature & ourMask) == ourMask;
+  if (maybeInPath && std::find(neigh_path.begin(), neigh_path.end(), routerPrefix_Uri) != neigh_path.end()) {
+    NS_LOG_DEBUG("===>> processDvInfoFromNeighbor => my prefix ( " << routerPrefix_Uri << " ) was found in next hops list << " << neigh_prefix << ".Ignoring it!");
+    NS_LOG_DEBUG("===>> prefix     : " << routerPrefix_Uri)
+    neigh_cost=100;
+    has_changed=true;
+    //SendHelloInterest();
+  }
+  /* Sanity checks: 1) ignore invalid seqNum; 2) ignore invalid Cost */
+  if (neigh_seq <= 0 || !isValidCost(neigh_cost))
+    return has_changed;
+
+  /* insert new prefix */
+  auto localRE = m_routingTable.LookupRoute(neigh_prefix);
+  if (localRE == nullptr) {
+    if (isInfinityCost(neigh_cost))
+      return has_changed;
+    NS_LOG_INFO("======>> New prefix! Just insert it " << neigh_prefix << " via " << neighbor.GetFaceId());
+    /* only new prefixes need a RoutingEntry built from the wire */
+    NextHop path;
+    for (const auto& router_id : neigh_path)
+      path.AddRouterId(router_id);
+    RoutingEntry re(neigh_prefix, neigh_seq, entry.originator(), std::move(path));
+    m_routingTable.UpsertNextHop(re, neighbor.GetFaceId(), CalculateCostToNeigh(neighbor, neigh_cost), neighbor.GetName());
+    return true;
+  }
 
+  /* Direct routes with higher sequence number means we should update ours */
+  if (localRE->isDirectRoute()) {
+    if (localRE->GetOriginator() == m_routerPrefix && neigh_seq > localRE->GetSeqNum()) {
+      m_routingTable.IncSeqNum(*localRE, 2);
       has_changed = true;
-      continue;
     }
+    return has_changed;
+  }
 
-    /* cost is "infinity", so remove it */
-    if (isInfinityCost(neigh_cost)) {
-      if (neigh_seq > localRE->GetSeqNum()) {
-        NS_LOG_INFO("======>> New SeqNum infinity cost, update! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq);
-        localRE->SetSeqNum(neigh_seq);
-      }
+  /* insert new next hop */
+  if (!localRE->isNextHop(neighbor.GetFaceId())) {
+    if (isInfinityCost(neigh_cost))
+      return has_changed;
 
-      NS_LOG_INFO("======>> Infinity cost! Remove nextHop for name prefix" << neigh_prefix << " nextHop=" << neighbor.GetFaceId());
-      m_routingTable.DeleteNextHop(*localRE, neighbor.GetFaceId());
+    NS_LOG_INFO("======>> New neighbor! Just insert it " << neigh_prefix << " via " << neighbor.GetFaceId());
 
-      // Now that we removed a NextHop, we eventually need to update the
-      // learnedFrom attribute to avoid local loops
-      if (localRE->GetNextHopsSize() == 1)
-        localRE->SetLearnedFrom(localRE->GetNextHopName(localRE->GetBestFaceId()));
+    // Learned from multiple next hop, so we can unset this var      
+    //localRE->SetLearnedFrom("");
+    //localRE->SetLearnedFrom(localRE->GetNextHopName(localRE->GetBestFaceId()));
 
-      has_changed = true;
-      continue;
-    }
-
-    // if (entry.second.GetLearnedFrom() == m_routerPrefix && !isInfinityCost(neigh_sec_cost))
-    //   neigh_cost = neigh_sec_cost;
+    m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), CalculateCostToNeigh(neighbor, neigh_cost), neighbor.GetName());
+    return true;
+  }
 
-    /* compare the Received and Local SeqNum (in Routing Entry)*/
-    neigh_cost = CalculateCostToNeigh(neighbor, neigh_cost);
+  /* cost is "infinity", so remove it */
+  if (isInfinityCost(neigh_cost)) {
     if (neigh_seq > localRE->GetSeqNum()) {
-      /* check if this update leads to the route being learned from ourself,
-       * if that is so it means we should remove this neighbor  */
-      if (entry.second.GetLearnedFrom() == m_routerPrefix) { //&& isInfinityCost(neigh_sec_cost)) {
-        NS_LOG_INFO("======>> New SeqNum and learned only from ourself! Remove nextHop for name prefix " << neigh_prefix << " nextHop=" << neighbor.GetFaceId() << " local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum" << neigh_seq);
-
-        localRE->SetSeqNum(neigh_seq);
-        m_routingTable.DeleteNextHop(*localRE, neighbor.GetFaceId());
-
-        // Now that we removed a NextHop, we eventually need to update the
-        // learnedFrom attribute to avoid local loops
-        //if (localRE->GetNextHopsSize() == 1)
-        //localRE->SetLearnedFrom(localRE->GetNextHopName(localRE->GetBestFaceId()));
-
-        has_changed = true;
-        continue;
-      }
-
-      NS_LOG_INFO("======>> New SeqNum, update name prefix! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq << " local_cost=" << localRE->GetCost(neighbor.GetFaceId()) << " neigh_cost=" << neigh_cost);
-      localRE->SetSeqNum(neigh_seq);
-      m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), neigh_cost, neighbor.GetName());
-      has_changed = true;
-      //// TODO:
-      ////   - Recv_Cost == Local_cost: update Local_SeqNum
-      ////   - Recv_Cost != Local_cost: wait SettlingTime, then update Local_Cost / Local_SeqNum
-      //if (localRE->GetCost() == neigh_cost) {
-      //  NS_LOG_INFO("======>> New SeqNum same cost, update name prefix! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq);
-      //  localRE->SetSeqNum(neigh_seq);
-      //  has_changed = true;
-      //  if (!localRE->isNextHop(neighbor.GetFaceId())) {
-      //    NS_LOG_INFO("======>> New SeqNum same cost from other next-hop, update!");
-      //    m_routingTable.UpdateRoute(*localRE, neighbor.GetFaceId());
-      //  }
-      //} else if (neigh_cost < localRE->GetCost()) {
-      //  NS_LOG_INFO("======>> New SeqNum diff lower cost, update name prefix! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq << " local_cost=" << localRE->GetCost() << " neigh_cost=" << neigh_cost);
-      //  /* Cost change will be handle by periodic updates */
-      //  localRE->SetCost(neigh_cost);
-      //  localRE->SetSeqNum(neigh_seq);
-      //  m_routingTable.UpdateRoute(*localRE, neighbor.GetFaceId());
-      //  has_changed = true;
-      //} else {
-      //  if (localRE->isNextHop(neighbor.GetFaceId()) || neigh_seq % 2 == 0) {
-      //    NS_LOG_INFO("======>> New SeqNum higher cost from same next-hop or even seq, update name prefix! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq);
-      //    localRE->SetCost(neigh_cost);
-      //    localRE->SetSeqNum(neigh_seq);
-      //    m_routingTable.UpdateRoute(*localRE, neighbor.GetFaceId());
-      //    has_changed = true;
-      //  } else {
-      //    NS_LOG_INFO("======>> New SeqNum higher cost from other next-hop and odd seqNum, just increase seqNum! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq);
-      //    localRE->SetSeqNum(neigh_seq);
-      //    has_changed = true;
-      //  }
-      //}
-    } else if (neigh_seq == localRE->GetSeqNum() && neigh_cost != localRE->GetCost(neighbor.GetFaceId())) {
-      NS_LOG_INFO("======>> Equal SeqNum but diff cost, update name prefix! local_cost=" << localRE->GetCost(neighbor.GetFaceId()) << " neigh_cost=" << neigh_cost);
-      /* Cost change will be handle by periodic updates */
-      // TODO: wait SettlingTime, then update Local_Cost
-      m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), neigh_cost, neighbor.GetName());
-      has_changed = true;
-    //} else if (neigh_seq == localRE->GetSeqNum() && neigh_cost == localRE->GetCost()) {
-    //  NS_LOG_INFO("======>> Equal SeqNum and Equal Cost, local_cost=" << localRE->GetCost());
-    //} else if (neigh_seq == localRE->GetSeqNum() && neigh_cost > localRE->GetCost()) {
-    //  //NS_LOG_INFO("======>> Equal SeqNum and (Equal or Worst Cost), however learn name prefix! local_cost=" << localRE->GetCost());
-    //  // TODO: save this new prefix as well to multipath
-    } else {
-      /* Recv_SeqNum < Local_SeqNu: discard/next, we already have a most recent update */
-      continue;
+      NS_LOG_INFO("======>> New SeqNum infinity cost, update! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq);
+      m_routingTable.SetSeqNum(*localRE, neigh_seq);
     }
+
+    NS_LOG_INFO("======>> Infinity cost! Remove nextHop for name prefix" << neigh_prefix << " nextHop=" << neighbor.GetFaceId());
+    /* the RoutingManager updates learnedFrom of the remaining next hops,
+     * or erases the entry (localRE must not be used after this) */
+    m_routingTable.DeleteNextHop(*localRE, neighbor.GetFaceId());
+    return true;
   }
 
-  if (has_changed) {
-    m_routingTable.IncVersion();
-    //UpdateRoutingTableDigest();
-    /* schedule a immediate ehlo message to notify neighbors about a new DvInfo */
-    //ResetHelloInterval();
-    SendHelloInterest();
+  /* compare the Received and Local SeqNum (in Routing Entry)*/
+  neigh_cost = CalculateCostToNeigh(neighbor, neigh_cost);
+  if (neigh_seq > localRE->GetSeqNum()) {
+    NS_LOG_INFO("======>> New SeqNum, update name prefix! local_seqNum=" << localRE->GetSeqNum() << " neigh_seqNum=" << neigh_seq << " local_cost=" << localRE->GetCost(neighbor.GetFaceId()) << " neigh_cost=" << neigh_cost);
+    m_routingTable.SetSeqNum(*localRE, neigh_seq);
+    m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), neigh_cost, neighbor.GetName());
+    return true;
+  } else if (neigh_seq == localRE->GetSeqNum() && neigh_cost != localRE->GetCost(neighbor.GetFaceId())) {
+    NS_LOG_INFO("======>> Equal SeqNum but diff cost, update name prefix! local_cost=" << localRE->GetCost(neighbor.GetFaceId()) << " neigh_cost=" << neigh_cost);
+    /* Cost change will be handle by periodic updates */
+    // TODO: wait SettlingTime, then update Local_Cost
+    m_routingTable.UpsertNextHop(*localRE, neighbor.GetFaceId(), neigh_cost, neighbor.GetName());
+    return true;
   }
+  /* Recv_SeqNum < Local_SeqNu: discard/next, we already have a most recent update */
+  return has_changed;
 }
 
 uint32_t
@@ -1069,17 +1999,15 @@ void Ndvr::AdvNamePrefix(std::string name) {
   //routingEntry.SetFaceId(0); /* directly connected */
   routingEntry.SetOriginator(m_routerPrefix.toUri()); /* directly connected */
 
-  /* If the application already started (ie., there is a Hello Event), then
-   * update the routing table and schedule a immediate ehlo message to notify
+  /* If the application already started (ie., the hello Trickle timer is
+   * running), then update the routing table and reset the timer to notify
    * neighbors about a new DvInfo; otherwise, just insert on the initial
    * routing table
    * */
   m_routingTable.insert(routingEntry);
   m_routingTable.IncVersion();
-  if (sendhello_event) {
-  //  ResetHelloInterval();
-    SendHelloInterest();
-  }
+  m_helloTrickle.Reset();
+  SchedDvInfoPush();
 }
 
 uint64_t Ndvr::CreateUnicastFace(std::string mac) {
@@ -4,10 +4,12 @@
 #define NDVR_HPP
 
 
+#include <deque>
 #include <iostream>
 #include <map>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <random>
 
 //#include <ns3/core-module.h>
@@ -16,12 +18,19 @@
 #include <ndn-cxx/security/key-chain.hpp>
 #include <ndn-cxx/security/signing-helpers.hpp>
 #include <ndn-cxx/security/validator-config.hpp>
+#include <ndn-cxx/util/rtt-estimator.hpp>
 #include <ndn-cxx/util/scheduler.hpp>
 #include <ndn-cxx/util/time.hpp>
 #include <ndn-cxx/mgmt/nfd/face-event-notification.hpp>
 #include <ndn-cxx/mgmt/nfd/face-monitor.hpp>
 
 #include "routing-table.hpp"
+#include "trickle-timer.hpp"
+#include "timer-wheel.hpp"
+#include "ndvr-hello.hpp"
+#include "dvinfo-codec.hpp"
+#include "dvinfo-validator.hpp"
+#include "worker-pool.hpp"
 #include "ndvr-message.pb.h"
 #include "ndvr-message-helper.hpp"
 
@@ -31,7 +40,35 @@ namespace ndvr {
 static const Name kNdvrPrefix = Name("/localhop/ndvr");
 static const Name kNdvrHelloPrefix = Name("/localhop/ndvr/dvannc");
 static const Name kNdvrDvInfoPrefix = Name("/localhop/ndvr/dvinfo");
+static const Name kNdvrDvPushPrefix = Name("/localhop/ndvr/dvpush");
 static const std::string kRouterTag = "%C1.Router";
+static const uint32_t kFaceCreateRetries = 5;
+/* routes learned from a neighbor expire on NFD after this many hello timeouts
+ * without being refreshed */
+static const uint32_t kRouteExpirationFactor = 2;
+/* bound of the hello silence a neighbor may announce, beyond it the neighbor
+ * is timed out anyway */
+static const time::seconds kMaxHelloSilence = time::seconds(60);
+static const std::string kProbeTag = "PROBE";
+/* DvInfo is published as segments whose Data packets fit the link MTU, so
+ * a lost frame costs a segment and not the whole DvInfo */
+static const size_t kDvInfoDefaultMtu = 1400;
+/* segments of a DvInfo requested in parallel */
+static const uint32_t kDvInfoWindow = 4;
+static const uint32_t kDvInfoSegmentRetries = 3;
+/* a retransmitted segment Interest lives RTO * 2^retx, up to this */
+static const time::milliseconds kDvInfoMaxLifetime = time::milliseconds(4000);
+static const time::seconds kDvInfoCacheLifetime = time::seconds(5);
+static const time::milliseconds kDvInfoPushDelay = time::milliseconds(10);
+/* DvInfo transfers in progress at once, other neighbors wait their turn */
+static const size_t kDvInfoMaxFetches = 8;
+/* upper bound of the backoff slot (see SchedDvInfoInterest), also used
+ * before the first RTT sample */
+static const time::milliseconds kDvInfoMaxSlot = time::milliseconds(20);
+static const std::string kMerkleTag = "MERKLE";
+/* Merkle reconciliation fetches up to this many buckets, beyond that a
+ * (delta) DvInfo is cheaper */
+static const size_t kMerkleMaxBuckets = 32;
 
 
 class NeighborEntry {
@@ -66,6 +103,14 @@ public:
     return m_version;
   }
 
+  /* last version of the neighbor's DvInfo we have applied (0 if none) */
+  void SetAppliedVersion(uint32_t ver) {
+    m_appliedVersion = ver;
+  }
+  uint32_t GetAppliedVersion() {
+    return m_appliedVersion;
+  }
+
   void SetFaceId(uint64_t faceId) {
     m_faceId = faceId;
   }
@@ -84,17 +129,133 @@ public:
   time::seconds GetHelloTimeout() {
     return m_helloTimeout;;
   }
+
+  /* flags of the last hello (HelloParams::FLAG_*) */
+  void SetHelloFlags(uint64_t flags) {
+    m_helloFlags = flags;
+  }
+  uint64_t GetHelloFlags() {
+    return m_helloFlags;
+  }
+
+  /* longest silence announced by the last hello (zero if none) */
+  void SetMaxSilence(time::milliseconds maxSilence) {
+    m_maxSilence = maxSilence;
+  }
+  time::milliseconds GetMaxSilence() {
+    return m_maxSilence;
+  }
+
+  /* digest announced by the last hello (all zeros for an empty table) */
+  void SetAnnouncedDigest(const uint8_t* digest, size_t size) {
+    m_announcedDigest.fill(0);
+    std::copy(digest, digest + std::min(size, m_announcedDigest.size()), m_announcedDigest.begin());
+  }
+
+  /* Merkle reconciliation: digests of the neighbor's buckets as of the
+   * routes we have from it (none until the first reconciliation) */
+  bool HasMerkleLeaves() {
+    return !m_merkleLeaves.empty();
+  }
+  IncrementalDigest::Bytes GetMerkleLeaf(size_t b) {
+    return m_merkleLeaves.empty() ? IncrementalDigest::Bytes() : m_merkleLeaves[b];
+  }
+  void SetMerkleLeaf(size_t b, const IncrementalDigest::Bytes& digest) {
+    if (m_merkleLeaves.empty())
+      m_merkleLeaves.resize(MerkleDigest::kBuckets, IncrementalDigest::Bytes());
+    m_merkleLeaves[b] = digest;
+  }
+  void ClearMerkleLeaves() {
+    m_merkleLeaves.clear();
+  }
+  /* digest of the i-th child of the root, computed from the leaves */
+  IncrementalDigest::Bytes GetMerkleNode(size_t i) {
+    IncrementalDigest node;
+    for (size_t b = i * MerkleDigest::kFanout; b < (i + 1) * MerkleDigest::kFanout; b++)
+      node.add(IncrementalDigest::fromBytes(GetMerkleLeaf(b).data()));
+    return node.toFixedBytes();
+  }
+  /* whether the leaves add up to the announced root */
+  bool IsMerkleSynced() {
+    if (m_merkleLeaves.empty())
+      return false;
+    IncrementalDigest root;
+    for (auto& leaf : m_merkleLeaves)
+      root.add(IncrementalDigest::fromBytes(leaf.data()));
+    return root.toFixedBytes() == m_announcedDigest;
+  }
+
+  /* sequence number of the next liveness probe */
+  uint64_t NextProbeSeq() {
+    return m_probeSeq++;
+  }
 public:
-  scheduler::EventId removal_event;
+  /* per-neighbor timers, on Ndvr's TimerWheel */
+  TimerWheel::Timer removal_event;
+  TimerWheel::Timer dvinfo_event;  /* scheduled DvInfo Interest (backoff) */
+  TimerWheel::Timer probe_event;  /* next liveness probe */
+  TimerWheel::Timer probe_timeout_event;  /* neighbor declared dead if no probe reply until then */
+  /* RTT of the DvInfo Interests to the neighbor, sets their lifetime and
+   * the backoff before them */
+  ndn::util::RttEstimator dvInfoRtt;
+  /* leaf digests learned by a reconciliation that fell back to pulling the
+   * DvInfo, only recorded once the DvInfo is applied */
+  std::vector<std::pair<size_t, IncrementalDigest::Bytes>> pendingMerkleLeaves;
 private:
   std::string m_name;
   uint64_t m_faceId;
   uint64_t m_version;
+  uint32_t m_appliedVersion = 0;
   time::steady_clock::TimePoint m_lastSeen;
   time::seconds m_helloTimeout;
+  uint64_t m_probeSeq = 0;
+  uint64_t m_helloFlags = 0;
+  time::milliseconds m_maxSilence = time::milliseconds::zero();
+  IncrementalDigest::Bytes m_announcedDigest = {};
+  std::vector<IncrementalDigest::Bytes> m_merkleLeaves;
   //TODO: key  
 };
 
+/* a segmented DvInfo being fetched from a neighbor */
+struct DvInfoFetch {
+  Name name;  /* DvInfo name, without the encoding and segment number */
+  Name encodedName;  /* name of the encoding segment 0 came from, empty until then */
+  uint64_t nSegments = 0;  /* 0 until segment 0 tells the FinalBlockId */
+  uint64_t nextSegment = 0;  /* next segment to be requested */
+  uint64_t nReceived = 0;
+  uint32_t nInFlight = 0;
+  std::vector<Block> segments;
+  std::vector<bool> received;
+};
+
+/* a Merkle reconciliation with a neighbor (see MerkleDigest) */
+struct MerkleSync {
+  uint64_t id = 0;  /* replies of older reconciliations are ignored */
+  /* only learning the leaves of a DvInfo just pulled, nothing to fetch */
+  bool learnOnly = false;
+  uint32_t pendingNodes = 0;
+  /* buckets that differ, with the neighbor's digests */
+  std::vector<std::pair<size_t, IncrementalDigest::Bytes>> leaves;
+  /* segmented buckets being fetched, by bucket */
+  std::map<size_t, DvInfoFetch> buckets;
+};
+
+/* the signed segments of an encoded DvInfo */
+struct DvInfoSegments {
+  Name name;  /* DvInfo name and encoding version, without the segment number */
+  uint32_t version = 0;  /* routing table version they were encoded from */
+  bool compact = false;  /* DvInfoCodec encoding */
+  time::steady_clock::TimePoint lastUsed;
+  std::vector<std::shared_ptr<const ndn::Data>> segments;
+};
+
+/* signed reply to a Merkle ROOT/NODE Interest, valid as long as the
+ * digest it lists the children of does not change */
+struct MerkleReply {
+  IncrementalDigest::Bytes digest;
+  std::shared_ptr<const ndn::Data> data;
+};
+
 class Error : public std::exception {
 public:
   Error(const std::string& what) : what_(what) {}
@@ -124,42 +285,133 @@ public:
     m_enableUnicastFaces = flag;
   }
 
+  /* minimum hello interval (Trickle Imin), in seconds */
   void SetHelloInterval(int x) {
-    m_helloIntervalCur = x;
+    m_helloTrickle.SetImin(time::seconds(x));
+  }
+
+  /* maximum hello interval (Trickle Imax), in seconds */
+  void SetMaxHelloInterval(int x) {
+    m_helloTrickle.SetImax(time::seconds(x));
+  }
+
+  void SetDirectFib(bool directFib) {
+    m_routingTable.SetDirectFib(directFib);
+  }
+
+  /* direct FIB mode: next hops we installed are recorded in @p filename,
+   * so that those left by a crashed run are removed by the next one */
+  void SetFibStateFile(const std::string& filename) {
+    m_routingTable.SetFibStateFile(filename);
+  }
+
+  /* liveness probes to the neighbors whose face (see StartProbing) is
+   * point-to-point, 0 disables them */
+  void SetProbeInterval(time::milliseconds interval) {
+    m_probeInterval = interval;
+  }
+
+  /* missed probe replies before a neighbor is declared dead */
+  void SetProbeDetectMultiplier(uint32_t mult) {
+    m_probeDetectMult = std::max(mult, 1u);
+  }
+
+  /* send compact DvInfo when every neighbor accepts it */
+  void SetCompactDvInfo(bool compact) {
+    m_compactDvInfo = compact;
+  }
+
+  /* push changes to the neighbors (see SchedDvInfoPush) */
+  void SetDvInfoPush(bool push) {
+    m_dvInfoPush = push;
+    m_dvInfoSegmentSize = 0;
+  }
+
+  /* reconcile with neighbors supporting it by descending their Merkle tree */
+  void SetMerkleSync(bool merkle) {
+    m_merkleSync = merkle;
+  }
+
+  /* validate and decode DvInfo on n worker threads, 0 does it all on the
+   * main thread */
+  void SetWorkerThreads(size_t n);
+
+  /* maximum size of a DvInfo Data packet (one segment) */
+  void SetDvInfoMtu(size_t mtu) {
+    m_dvInfoMtu = mtu;
+    m_dvInfoSegmentSize = 0;
   }
 
 private:
   typedef std::map<std::string, NeighborEntry> NeighborMap;
+  typedef std::map<std::string, DvInfoFetch> DvInfoFetchMap;
 
   void processInterest(const ndn::Interest& interest);
   void OnHelloInterest(const ndn::Interest& interest, uint64_t inFaceId);
   void OnKeyInterest(const ndn::Interest& interest);
+  void OnProbeInterest(const ndn::Interest& interest);
+  void StartProbing(const std::string& neigh);
+  void SendProbe(const std::string& neigh);
+  void OnProbeReply(const std::string& neigh);
+  void RescheduleProbeTimeout(NeighborEntry& neighbor);
   void OnDvInfoInterest(const ndn::Interest& interest);
   void ReplyDvInfoInterest(const ndn::Interest& interest);
-  void OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data);
+  DvInfoSegments& GetCurrentDvInfoSegments(const Name& dvInfoName);
+  void BuildDvInfoSegments(const Name& dvInfoName, DvInfoSegments& out);
+  size_t GetDvInfoSegmentSize();
+  void PruneDvInfoCache();
+  void OnDvInfoContent(const ndn::Interest& interest, const ndn::Data& data, uint32_t retx,
+                       time::steady_clock::TimePoint sentAt);
   void OnDvInfoTimedOut(const ndn::Interest& interest, uint32_t retx);
-  void OnDvInfoNack(const ndn::Interest& interest, const ndn::lp::Nack& nack);
+  void OnDvInfoNack(const ndn::Interest& interest, const ndn::lp::Nack& nack, uint32_t retx);
   void SchedDvInfoInterest(NeighborEntry& neighbor, bool wait = false, uint32_t retx = 0);
   void SendDvInfoInterest(const std::string& neighbor_name, uint32_t retx = 0);
+  void PullDvInfo(const std::string& neighbor_name, uint32_t retx = 0);
+  void SendDvInfoSegment(NeighborEntry& neighbor, DvInfoFetch& fetch, uint64_t segment, uint32_t retx = 0);
+  DvInfoFetchMap::iterator FindDvInfoFetch(const Name& segmentName);
+  void EndDvInfoFetch(DvInfoFetchMap::iterator fetch_it);
+  size_t CountNeighborsOnFace(uint64_t faceId);
   void OnValidatedDvInfo(const ndn::Data& data);
+  void ApplyDvInfo(NeighborEntry& neighbor, const uint8_t* buf, size_t size,
+                   const std::function<void(NeighborEntry&)>& onApplied = nullptr);
+  static bool DecodeDvInfo(const std::string& encoded, proto::DvInfo& dvinfo);
+  void SchedDvInfoPush();
+  void SendDvInfoPush();
+  Interest MakeDvInfoPushInterest(uint32_t version, const ndn::Data& segment);
+  void OnDvPushInterest(const ndn::Interest& interest);
+  void OnValidatedDvPush(const ndn::Data& data);
+  void ReplyMerkleInterest(const ndn::Interest& interest);
+  void EncodeDvInfoBucket(std::string& out, size_t bucket);
+  void StartMerkleSync(const std::string& neighbor_name, bool learnOnly = false);
+  Name GetMerkleName(const std::string& neighbor_name, const Name& suffix);
+  void SendMerkleInterest(const std::string& neighbor_name, uint64_t id, const Name& name, bool canBePrefix = false);
+  void OnMerkleData(const std::string& neighbor_name, uint64_t id, const ndn::Data& data);
+  void AbortMerkleSync(const std::string& neighbor_name, uint64_t id);
+  bool ApplyMerkleBucket(NeighborEntry& neighbor, size_t bucket, const uint8_t* buf, size_t size);
+  void EndMerkleSync(const std::string& neighbor_name);
   void OnDvInfoValidationFailed(const ndn::Data& data, const ndn::security::v2::ValidationError& ve);
   void SendHelloInterest();
   void registerPrefixes();
+  void bringUpFace(const std::string& face, uint32_t attempt = 0);
+  void onFaceReady(uint64_t faceId);
   void registerNeighborPrefix(NeighborEntry& neighbor, uint64_t oldFaceId, uint64_t newFaceId);
   bool isInfinityCost(uint32_t cost);
   bool isValidCost(uint32_t cost);
-  void EncodeDvInfo(std::string& out);
-  void processDvInfoFromNeighbor(NeighborEntry& neighbor, RoutingTable& dvinfo_other);
+  void EncodeDvInfo(std::string& out, uint32_t sinceVersion = 0, bool compact = false);
+  bool UseCompactDvInfo();
+  void EncodeDvInfoEntry(const std::string& prefix, RoutingEntry& re, proto::DvInfo_Entry* entry);
+  bool processDvInfoFromNeighbor(NeighborEntry& neighbor, const uint8_t* buf, size_t size, uint32_t& version);
+  void processDecodedDvInfo(NeighborEntry& neighbor, const proto::DvInfo& dvinfo);
+  bool processDvInfoEntry(NeighborEntry& neighbor, const proto::DvInfo_Entry& entry);
+  bool processDvInfoWithdrawn(NeighborEntry& neighbor, const std::string& prefix);
   uint32_t CalculateCostToNeigh(NeighborEntry&, uint32_t cost);
-  void IncreaseHelloInterval();
-  void ResetHelloInterval();
   uint64_t ExtractIncomingFace(const ndn::Interest& interest);
   uint64_t ExtractIncomingFace(const ndn::Data& data);
   void UpdateNeighHelloTimeout(NeighborEntry& neighbor);
   void RescheduleNeighRemoval(NeighborEntry& neighbor);
   void RemoveNeighbor(const std::string neigh);
   uint64_t CreateUnicastFace(std::string mac);
-  std::string GetNeighborToken();
+  std::vector<Name> GetNeighborToken();
   void UpdateRoutingTableDigest();
   void onFaceEventNotification(const ndn::nfd::FaceEventNotification& faceEventNotification);
 
@@ -168,6 +420,7 @@ private:
   {
     m_routerPrefix = m_network;
     m_routerPrefix.append(m_routerName);
+    m_routerId = RouterIdTable::instance().intern(m_routerPrefix.toUri());
   }
   
   /** @brief check if it is a valid router by extracting the router tag 
@@ -204,34 +457,56 @@ private:
     return name.getSubName(prefix.size(), 3).toUri();
   }
 
-  /** @brief Extracts the number of prefixes annouced by the neighbor
+  /** @brief Extracts the neighbor version requested by a DvInfo Interest
    *
-   * @param name: The interest name received from a neighbor. It 
-   * should be formatted:
-   *    <NDVR_HELLO_PREFIX>/<network>/%C1.Router/<router_name>/<num_prefix>/<digest>/<version>(/<params>?)
+   * @param name: The DvInfo interest name. It should be formatted:
+   *    <NDVR_DVINFO_PREFIX>/<network>/%C1.Router/<router_name>/<version>(/<since_version>)(/<encoding>/<segment>)
    */
-  uint32_t ExtractNumPrefixesFromAnnounce(const Name& name) {
-    return name.get(kNdvrHelloPrefix.size()+3).toNumber();
+  uint32_t ExtractVersionFromDvInfo(const Name& name) {
+    return name.get(kNdvrDvInfoPrefix.size()+3).toNumber();
   }
 
-  /** @brief Extracts the digest annouced by the neighbor
+  /** @brief Extracts the version the requester has already applied from
+   * a DvInfo Interest name, or 0 if it was not provided (full DvInfo)
    *
-   * @param name: The interest name received from a neighbor. It 
-   * should be formatted:
-   *    <NDVR_HELLO_PREFIXX>/<network>/%C1.Router/<router_name>/<num_prefix>/<digest>/<version>(/<params>?)
+   * @param name: The DvInfo interest name. It should be formatted:
+   *    <NDVR_DVINFO_PREFIX>/<network>/%C1.Router/<router_name>/<version>(/<since_version>)(/<encoding>/<segment>)
    */
-  std::string ExtractDigestFromAnnounce(const Name& name) {
-    return name.get(kNdvrHelloPrefix.size()+3+1).toUri();
+  uint32_t ExtractSinceVersionFromDvInfo(const Name& name) {
+    Name dvInfoName = GetDvInfoBaseName(name);
+    if (dvInfoName.size() <= kNdvrDvInfoPrefix.size()+4)
+      return 0;
+    return dvInfoName.get(kNdvrDvInfoPrefix.size()+4).toNumber();
   }
 
-  /** @brief Extracts the version annouced by the neighbor
-   *
-   * @param name: The interest name received from a neighbor. It 
-   * should be formatted:
-   *    <NDVR_HELLO_PREFIXX>/<network>/%C1.Router/<router_name>/<num_prefix>/<digest>/<version>(/<params>?)
+  /** @brief Strips the encoding version and segment number from a DvInfo
+   * name, if any
    */
-  uint32_t ExtractVersionFromAnnounce(const Name& name) {
-    return name.get(kNdvrHelloPrefix.size()+3+2).toNumber();
+  Name GetDvInfoBaseName(const Name& name) {
+    Name dvInfoName = name;
+    if (!dvInfoName.empty() && dvInfoName.get(-1).isSegment())
+      dvInfoName = dvInfoName.getPrefix(-1);
+    if (!dvInfoName.empty() && dvInfoName.get(-1).isVersion())
+      dvInfoName = dvInfoName.getPrefix(-1);
+    return dvInfoName;
+  }
+
+  /** @brief Segment number of a DvInfo name, 0 for a name without it (the
+   * Interest for segment 0)
+   */
+  uint64_t GetDvInfoSegment(const Name& name) {
+    if (!name.empty() && name.get(-1).isSegment())
+      return name.get(-1).toSegment();
+    return 0;
+  }
+
+  /** @brief Whether a name under NDVR_DVINFO_PREFIX is a Merkle
+   * reconciliation name rather than a DvInfo one:
+   *    <NDVR_DVINFO_PREFIX>/<network>/%C1.Router/<router_name>/MERKLE/...
+   */
+  bool IsMerkleName(const Name& name) {
+    return name.size() > kNdvrDvInfoPrefix.size()+3 &&
+           name.get(kNdvrDvInfoPrefix.size()+3).toUri() == kMerkleTag;
   }
 
   const ndn::security::SigningInfo&
@@ -244,12 +519,13 @@ private:
   const ndn::security::SigningInfo& m_signingInfo;
   ndn::Face m_face;
   ndn::Scheduler m_scheduler;
-  ndn::ValidatorConfig m_validator;
+  /* per-neighbor timers (rescheduled on every hello) live on a timer wheel
+   * instead of the scheduler's heap */
+  TimerWheel m_timerWheel;
+  DvInfoValidator m_validator;
   uint32_t m_seq;
   //std::uniform_int_distribution<int> m_rand_nonce(0,std::numeric_limits<int>::max());
-  //std::uniform_int_distribution<int> m_rand_backoff(0, 19999);
   std::uniform_int_distribution<int> m_rand_nonce;
-  std::uniform_int_distribution<int> m_rand_backoff;
   Name m_network;
   Name m_routerName;
   std::vector<std::string> m_listenFaces;
@@ -257,34 +533,56 @@ private:
 
   ndn::KeyChain m_keyChain;
   Name m_routerPrefix;
+  RouterIdTable::Id m_routerId = 0;  /* m_routerPrefix interned on the RouterIdTable */
   NeighborMap m_neighMap;
   std::map<std::string, uint64_t> m_neighToFaceId;
   RoutingManager m_routingTable;
-  int m_helloIntervalIni;
-  int m_helloIntervalCur;
-  int m_helloIntervalMax;
-  time::steady_clock::TimePoint m_nextHelloTime = time::steady_clock::TimePoint::max();
+  /* hellos are sent by a Trickle timer: the interval goes from Imin (1s) up
+   * to Imax (2s) while neighbors are consistent with us, and back to Imin on
+   * changes */
+  TrickleTimer m_helloTrickle;
   int m_localRTInterval;
   int m_localRTTimeout;
+  /* BFD-like liveness probes: a probe Interest every m_probeInterval to
+   * neighbors on point-to-point faces, declared dead after
+   * m_probeDetectMult intervals without a reply */
+  time::milliseconds m_probeInterval = time::milliseconds(100);
+  uint32_t m_probeDetectMult = 3;
   bool m_enableUnicastFaces = true;
   std::string m_macaddr;
-  /* m_slotTime (microseconds)
-   * SlotTime is the time to transmit a frame on the physical medium
-   * (e.g., 802.3 100Mbps is 51us, 802.11b is 20us, 802.11ac is 9us,
-   * etc.). Should be a configuration parameter */
-  uint32_t m_slotTime = 40000;
-  /* m_c
-   * Let m_c be the cth try to avoid sending a redundant DvInfo interest.
-   * It starts with 1 and can increase if we still detect redundant
-   * DvInfo interest.
-   * */
-  uint32_t m_c = 4;
-  /* For DvInfo interest suppression */
-  std::unordered_map<std::string, scheduler::EventId> dvinfointerest_event;
-
-  scheduler::EventId sendhello_event;  /* async send hello event scheduler */
-  scheduler::EventId increasehellointerval_event;  /* increase hello interval event scheduler */
+
   scheduler::EventId replydvinfo_event;  /* group dvinfo replies to avoid duplicate */
+  std::map<Name, Interest> m_pendingDvInfoReplies;  /* distinct DvInfo Interests grouped by replydvinfo_event */
+  /* Encoded and signed DvInfo segments by encoding name (DvInfo name plus
+   * a version component identifying the encoding). Neighbors asking for
+   * the same DvInfo name (same version and since-version) get the very same
+   * Data, without encoding nor signing it again. A new encoding (routing
+   * table change) gets a new name, so segments of different encodings are
+   * never mixed in a transfer. Encodings that are no longer current only
+   * serve transfers already in progress, and are dropped after
+   * kDvInfoCacheLifetime without being asked for */
+  std::map<Name, DvInfoSegments> m_dvInfoCache;
+  std::map<Name, Name> m_currentDvInfo;  /* DvInfo name -> name of its current encoding */
+  uint64_t m_lastDvInfoEncoding = 0;
+  /* ROOT and NODE replies by name, signed again only when their digest
+   * changes */
+  std::map<Name, MerkleReply> m_merkleReplies;
+  uint64_t m_dvInfoCacheHits = 0;
+  uint64_t m_dvInfoCacheMisses = 0;
+  uint64_t m_dvInfoSegmentsServed = 0;
+  uint64_t m_dvInfoSegmentsSigned = 0;
+  size_t m_dvInfoMtu = kDvInfoDefaultMtu;
+  size_t m_dvInfoSegmentSize = 0;  /* DvInfo bytes per segment, computed from m_dvInfoMtu */
+  DvInfoFetchMap m_dvInfoFetches;  /* by neighbor */
+  /* neighbors waiting for a DvInfo transfer (kDvInfoMaxFetches) */
+  std::deque<std::string> m_dvInfoFetchQueue;
+  bool m_compactDvInfo = false;
+  bool m_dvInfoPush = false;
+  uint32_t m_lastPushedVersion = 0;  /* pushes carry the changes since then */
+  bool m_merkleSync = false;
+  std::map<std::string, MerkleSync> m_merkleSyncs;  /* by neighbor */
+  uint64_t m_merkleSyncId = 0;
+  scheduler::EventId dvinfopush_event;  /* group changes into a single push */
   std::random_device rdevice_;
   std::mt19937 m_rengine;
   std::uniform_int_distribution<> replydvinfo_dist = std::uniform_int_distribution<>(100, 150);   /* milliseconds */
@@ -299,6 +597,11 @@ private:
   /* m_faceMonitor - monitor /localhost/nfd/faces/events through nfd
    * API - which leverage CallBacks to make NDVR aware of events */
   ndn::nfd::FaceMonitor m_faceMonitor;
+
+  /* DvInfo validation and decoding off the main thread (see
+   * SetWorkerThreads). Last member: it is destroyed (and its threads
+   * joined) before anything its jobs complete on */
+  std::unique_ptr<WorkerPool> m_workers;
 };
 
 } // namespace ndvr
@@ -0,0 +1,112 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_ROUTER_ID_TABLE_HPP
+#define NDVR_ROUTER_ID_TABLE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief process-wide table of interned router names
+ *
+ * Router names (e.g., /ndn/%C1.Router/rtr1) show up on every routing entry,
+ * either as the neighbor a next hop was learned from or on path vectors.
+ * Interning them gives each name a small integer id, so entries can store
+ * ids instead of copies of the string and compare them cheaply.
+ *
+ * Id 0 is reserved for the empty name. Ids are never released, since
+ * nothing tracks which entries still refer to them: the table grows with
+ * every distinct router name ever seen (the name, twice, plus a few dozen
+ * bytes) and only a restart shrinks it. That is fine for a network of
+ * stable routers; a network whose router names keep changing would need
+ * the ids to be reference counted. The table is only used from the main
+ * thread.
+ *
+ * Each router also has a 64-bit Bloom mask (3 bits set) derived from its
+ * name, so that path vectors can carry a signature of the routers they
+ * contain. The mask only depends on the name, hence it is the same on every
+ * router and can be sent on the wire.
+ */
+class RouterIdTable {
+public:
+  typedef uint32_t Id;
+  typedef uint64_t Signature;
+
+  static RouterIdTable& instance() {
+    static RouterIdTable table;
+    return table;
+  }
+
+  /** @brief returns the id of @p name, allocating a new one if needed */
+  Id intern(const std::string& name) {
+    if (name.empty())
+      return 0;
+    auto it = m_ids.find(name);
+    if (it != m_ids.end())
+      return it->second;
+    Id id = static_cast<Id>(m_names.size());
+    m_names.push_back(name);
+    m_masks.push_back(bloomMask(name));
+    m_ids.emplace(name, id);
+    return id;
+  }
+
+  /** @brief returns the name of @p id, or the empty name if it is unknown
+   *
+   * The reference stays valid while the table exists, even across intern()
+   * calls, as names are never moved nor released.
+   */
+  const std::string& lookup(Id id) const {
+    if (id >= m_names.size())
+      return m_names[0];
+    return m_names[id];
+  }
+
+  /** @brief returns the Bloom mask of @p id (0 for the empty name) */
+  Signature mask(Id id) const {
+    if (id >= m_masks.size())
+      return 0;
+    return m_masks[id];
+  }
+
+  size_t size() const {
+    return m_names.size();
+  }
+
+  /** @brief Bloom mask of a router name: 3 bits chosen from the FNV-1a
+   * hash of the name */
+  static Signature bloomMask(const std::string& name) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : name) {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return (Signature(1) << (h & 63)) |
+           (Signature(1) << ((h >> 6) & 63)) |
+           (Signature(1) << ((h >> 12) & 63));
+  }
+
+private:
+  RouterIdTable()
+    : m_names(1)
+    , m_masks(1, 0)
+  {
+  }
+
+private:
+  /* a deque, so that references returned by lookup() survive growth */
+  std::deque<std::string> m_names;
+  std::vector<Signature> m_masks;
+  std::unordered_map<std::string, Id> m_ids;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_ROUTER_ID_TABLE_HPP
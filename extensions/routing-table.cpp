@@ -1,6 +1,7 @@
 #include <iostream>
 #include <sstream> 
 #include <string>
+#include <set>
 #include <future>         // std::promise, std::future
 #include <boost/uuid/detail/sha1.hpp>
 
@@ -89,157 +90,116 @@ void RoutingManager::enableLocalFields() {
       options);
 }
 
-uint64_t RoutingManager::createFace(std::string faceUri) {
-  uint64_t faceId;
-  //bool hasError = false;
-  ndn::FaceUri localUri(faceUri);
-  ndn::FaceUri remoteUri("ether://[ff:ff:ff:ff:ff:ff]");
-  ndn::FaceUri canonicalRemote, canonicalLocal;
-
-  std::string error;
-  remoteUri.canonize(
-    [&canonicalRemote] (const FaceUri& canonicalUri) { canonicalRemote = canonicalUri; },
-    [&error] (const std::string& errorReason) { error = errorReason; },
-    m_face.getIoService(), time::seconds(1));
-
-  if (!error.empty()) {
-    std::cerr << now_str() << "Fail to canonize remote face: " << error << std::endl;
-    return 0;
-  }
-
-  error.clear();
-  localUri.canonize(
-    [&canonicalLocal] (const FaceUri& canonicalUri) { canonicalLocal = canonicalUri; },
-    [&error] (const std::string& errorReason) { error = errorReason; },
-    m_face.getIoService(), time::seconds(1));
+void RoutingManager::queryFaceLinkType(uint64_t faceId, std::function<void(ndn::nfd::LinkType)> cb) {
+  ndn::nfd::FaceQueryFilter filter;
+  filter.setFaceId(faceId);
+  m_controller->fetch<ndn::nfd::FaceQueryDataset>(
+    filter,
+    [cb] (const std::vector<ndn::nfd::FaceStatus>& faces) {
+      cb(faces.empty() ? ndn::nfd::LINK_TYPE_NONE : faces.front().getLinkType());
+    },
+    [faceId, cb] (uint32_t code, const std::string& reason) {
+      std::cerr << now_str() << "Fail to query face faceId=" << faceId << ": code=" << code << " error=" << reason << std::endl;
+      cb(ndn::nfd::LINK_TYPE_NONE);
+    });
+}
 
-  if (!error.empty()) {
-    std::cerr << now_str() << "Fail to canonize local face: " << error << std::endl;
-    return 0;
+/* Face creation is fully asynchronous: the remote and local URIs are
+ * canonized and then the face is created, each step continuing from the
+ * callback of the previous one. Several faces can be brought up at once. */
+void RoutingManager::createFace(const std::string& faceUri, std::function<void(uint64_t)> onCreated,
+                                std::function<void(const std::string&)> onFailure) {
+  ndn::FaceUri localUri, remoteUri;
+  if (!localUri.parse(faceUri)) {
+    onFailure("invalid face uri " + faceUri);
+    return;
   }
+  remoteUri.parse("ether://[ff:ff:ff:ff:ff:ff]");
 
-  //remoteUri.canonize(
-  //  [&] (const FaceUri& canonicalUri) {
-  //    canonicalRemote = canonicalUri;
-  //    localUri.canonize(
-  //      [&] (const FaceUri& canonicalUri) {
-  //        canonicalLocal = canonicalUri;
-  //      },
-  //      [&] (const std::string& error) {
-  //        std::cerr << now_str() << "Fail to canonize face: " << error << std::endl;
-  //        hasError = true;
-  //      },
-  //      m_face.getIoService(), time::seconds(1));
-  //  },
-  //  [&] (const std::string& error) {
-  //    std::cerr << now_str() << "Fail to canonize face: " << error << std::endl;
-  //    hasError = true;
-  //  },
-  //  m_face.getIoService(), time::seconds(1));
-
-  //if (hasError) {
-  //  return 0;
-  //}
-
-  ndn::nfd::ControlParameters faceParameters;
-  faceParameters.setUri(canonicalRemote.toString());
-  faceParameters.setLocalUri(canonicalLocal.toString());
-  faceParameters.setFacePersistency(::ndn::nfd::FacePersistency::FACE_PERSISTENCY_PERSISTENT);
-  faceId = 0;
-
-  ::ndn::nfd::CommandOptions options;
-  options.setTimeout(time::duration_cast<time::milliseconds>(time::seconds(1)));
-  
   std::cerr << now_str() << "creating face uri=" << faceUri << std::endl;
-  m_controller->start<::ndn::nfd::FaceCreateCommand>(
-      faceParameters,
-      [&faceId] (const ::ndn::nfd::ControlParameters& resp) {
-        std::cerr << now_str() << "New face created: faceId=" << resp.getFaceId() << " faceLocalUri=" << resp.getLocalUri() << std::endl;
-        faceId = resp.getFaceId();
-      },
-      [&] (const ::ndn::nfd::ControlResponse& resp) {
-        std::cerr << now_str() << "Fail to create face: status=" << resp.getCode() << " error=" << resp.getText() << std::endl;
-      },
-      options);
-  // TODO: it is async, how to wait until the face is created ?
-  // TODO: Fail to create face: status=406 error=Cannot create multicast Ethernet faces
-  //m_face.processEvents();
-  std::cerr << now_str() << "creating face faceId=" << faceId << std::endl;
-  return faceId;
+  remoteUri.canonize(
+    [this, localUri, faceUri, onCreated, onFailure] (const FaceUri& canonicalRemote) {
+      localUri.canonize(
+        [this, canonicalRemote, faceUri, onCreated, onFailure] (const FaceUri& canonicalLocal) {
+          ndn::nfd::ControlParameters faceParameters;
+          faceParameters.setUri(canonicalRemote.toString());
+          faceParameters.setLocalUri(canonicalLocal.toString());
+          faceParameters.setFacePersistency(::ndn::nfd::FacePersistency::FACE_PERSISTENCY_PERSISTENT);
+
+          ::ndn::nfd::CommandOptions options;
+          options.setTimeout(time::duration_cast<time::milliseconds>(time::seconds(1)));
+
+          m_controller->start<::ndn::nfd::FaceCreateCommand>(
+            faceParameters,
+            [faceUri, onCreated] (const ::ndn::nfd::ControlParameters& resp) {
+              std::cerr << now_str() << "New face created: faceId=" << resp.getFaceId() << " faceUri=" << faceUri << " faceLocalUri=" << resp.getLocalUri() << std::endl;
+              onCreated(resp.getFaceId());
+            },
+            [faceUri, onCreated, onFailure] (const ::ndn::nfd::ControlResponse& resp) {
+              /* 409: the face already exists (e.g., left by a previous run), NFD tells us its id */
+              if (resp.getCode() == 409) {
+                try {
+                  ::ndn::nfd::ControlParameters existing(resp.getBody());
+                  std::cerr << now_str() << "Face already exists: faceId=" << existing.getFaceId() << " faceUri=" << faceUri << std::endl;
+                  onCreated(existing.getFaceId());
+                  return;
+                }
+                catch (const std::exception& e) {
+                  std::cerr << now_str() << "Fail to decode existing face: " << e.what() << std::endl;
+                }
+              }
+              onFailure("face create status=" + std::to_string(resp.getCode()) + " error=" + resp.getText());
+            },
+            options);
+        },
+        [onFailure] (const std::string& error) { onFailure("canonize local face: " + error); },
+        m_face.getIoService(), time::seconds(1));
+    },
+    [onFailure] (const std::string& error) { onFailure("canonize remote face: " + error); },
+    m_face.getIoService(), time::seconds(1));
 }
 
-void RoutingManager::registerPrefix(const std::string name, uint64_t faceId, uint32_t cost, uint8_t retry) {
+/* Route (un)registrations go through the FibUpdateQueue, which coalesces
+ * them per (name, faceId) and bounds the commands in flight to NFD */
+void RoutingManager::registerPrefix(const std::string name, uint64_t faceId, uint32_t cost, FibUpdateQueue::Priority priority,
+                                    std::function<void()> onInstalled) {
   //using namespace ns3;
   //using namespace ns3::ndn;
-
-  std::cerr << now_str() << "registerPrefix name=" << name << " faceId=" << faceId << std::endl;
-
-  Name namePrefix = Name(name);
   //Ptr<Node> thisNode = NodeList::GetNode(Simulator::GetContext());
   //FibHelper::AddRoute(thisNode, namePrefix, faceId, cost);
-
-  ::ndn::nfd::ControlParameters controlParameters;
-  controlParameters
-    .setName(namePrefix)
-    .setFaceId(faceId)
-    .setCost(cost);
-  ::ndn::nfd::CommandOptions options;
-  options.setTimeout(time::duration_cast<time::milliseconds>(time::seconds(1)));
-  std::cerr << now_str() << "registerPrefix call controller name=" << name << " faceId=" << faceId << std::endl;
-  m_controller->start<::ndn::nfd::RibRegisterCommand>(controlParameters,
-      std::bind(&RoutingManager::onRegistrationSuccess, this, _1),
-      std::bind(&RoutingManager::onRegistrationFailure, this, _1, controlParameters, retry),
-      options);
-  std::cerr << now_str() << "done registerPrefix name=" << name << " faceId=" << faceId << std::endl;
+  m_fibQueue->Register(Name(name), faceId, cost, std::min(priority, PriorityOf(name)), std::move(onInstalled));
 }
 
-void
-RoutingManager::onRegistrationSuccess(const ndn::nfd::ControlParameters& param)
-{
-  std::cerr << now_str() << "register rib success name=" << param.getName() << " faceId=" << param.getFaceId() << std::endl;
+void RoutingManager::unregisterPrefix(const std::string name, const uint64_t faceId, FibUpdateQueue::Priority priority) {
+  //using namespace ns3;
+  //using namespace ns3::ndn;
+  //Ptr<Node> thisNode = NodeList::GetNode(Simulator::GetContext());
+  //FibHelper::RemoveRoute(thisNode, namePrefix, faceId);
+  m_fibQueue->Unregister(Name(name), faceId, std::min(priority, PriorityOf(name)));
 }
 
-void
-RoutingManager::onRegistrationFailure(const ndn::nfd::ControlResponse& resp,
-                           const ndn::nfd::ControlParameters& param,
-                           uint8_t retry)
-{
-  std::cerr << now_str() << "Fail to create FIB entry (name=" << param.getName() << " faceId=" << param.getFaceId() << " retry=" << retry << "): code=" << resp.getCode() << " error=" << resp.getText() << std::endl;
-  if (retry < 3) {
-    registerPrefix(param.getName().toUri(), param.getFaceId(), param.getCost(), retry+1);
-  }
+void RoutingManager::onFaceDestroyed(uint64_t faceId) {
+  m_fibQueue->ForgetFace(faceId);
 }
 
-void RoutingManager::unregisterPrefix(const std::string name, const uint64_t faceId) {
-  //using namespace ns3;
-  //using namespace ns3::ndn;
+constexpr time::seconds RoutingManager::kReconcileInterval;
+constexpr time::seconds RoutingManager::kAdoptionGrace;
 
-  std::cerr << now_str() << "unregisterPrefix name=" << name << " faceId=" << faceId << std::endl;
-  Name namePrefix = Name(name);
-  //Ptr<Node> thisNode = NodeList::GetNode(Simulator::GetContext());
-  //FibHelper::RemoveRoute(thisNode, namePrefix, faceId);
+/* NFD is reconciled against the routes we want every kReconcileInterval.
+ * The first pass adopts routes left by a previous run, which are only
+ * removed if not learned again within kAdoptionGrace */
+void RoutingManager::StartReconciler() {
+  m_fibQueue->StartReconciler(kReconcileInterval, kAdoptionGrace);
+}
 
-  ::ndn::nfd::ControlParameters controlParameters;
-  controlParameters
-    .setName(namePrefix)
-    .setFaceId(faceId);
-  //::ndn::nfd::CommandOptions options;
-  //options.setTimeout(time::duration_cast<time::milliseconds>(time::seconds(1)));
-  std::cerr << now_str() << "unregisterPrefix call controller name=" << name << " faceId=" << faceId << std::endl;
-  try {
-  m_controller->start<::ndn::nfd::RibUnregisterCommand>(controlParameters,
-      [] (const ::ndn::nfd::ControlParameters& commandSuccessResult) {
-        std::cerr << now_str() << "unregister rib success name=" << commandSuccessResult.getName() << " faceId=" << commandSuccessResult.getFaceId() << std::endl;
-      },
-      [] (const ::ndn::nfd::ControlResponse& resp) {
-        std::cerr << now_str() << "unregister rib fail: code=" << resp.getCode() << " error=" << resp.getText() << std::endl;
-      }
-      //,options);
-      );
-  } catch (const std::exception& e) {
-    std::cerr << now_str() << "unregister exception: " << e.what() << std::endl;
-  }
-  std::cerr << now_str() << "done unregisterPrefix name=" << name << " faceId=" << faceId << std::endl;
+void RoutingManager::cleanup() {
+  m_fibQueue->UnregisterAll();
+}
+
+FibUpdateQueue::Priority RoutingManager::PriorityOf(const std::string& name) {
+  if (name.find("/%C1.Router/") != std::string::npos)
+    return FibUpdateQueue::PRIORITY_HIGH;
+  return FibUpdateQueue::PRIORITY_NORMAL;
 }
 
 bool RoutingManager::isDirectRoute(std::string n) {
@@ -256,6 +216,19 @@ RoutingEntry* RoutingManager::LookupRoute(std::string n) {
   return &it->second;
 }
 
+/* Strip one component at a time until a stored prefix is found */
+RoutingEntry* RoutingManager::LongestPrefixMatch(std::string n) {
+  for (;;) {
+    auto it = m_rt.find(n);
+    if (it != m_rt.end())
+      return &it->second;
+    size_t slash = n.rfind('/');
+    if (slash == std::string::npos || n.size() <= 1)
+      return nullptr;
+    n.resize(std::max<size_t>(slash, 1));
+  }
+}
+
 //void RoutingManager::UpdateRoute(RoutingEntry& e, uint64_t new_nh) {
 //  if (e.GetFaceId() != new_nh) {
 //    unregisterPrefix(e.GetName(), e.GetFaceId());
@@ -271,56 +244,220 @@ RoutingEntry* RoutingManager::LookupRoute(std::string n) {
 //}
 
 void RoutingManager::UpsertNextHop(RoutingEntry& e, uint64_t faceId, uint32_t cost, std::string neighName) {
-  std::cerr << now_str() << "====> start RoutingEntry.UpsertNextHop" << std::endl;
   if (!e.isNextHop(faceId) || e.GetCost(faceId)!=cost)
      registerPrefix(e.GetName(), faceId, cost);
   e.UpsertNextHop(faceId, cost, neighName);
-  std::cerr << now_str() << "====> done with RoutingEntry.UpsertNextHop" << std::endl;
-  m_rt[e.GetName()] = e;
-  UpdateDigest();
+  store(e);
 }
 
 void RoutingManager::DeleteNextHop(RoutingEntry& e, uint64_t faceId) {
-  std::cerr << now_str() << "====> start RoutingEntry.DeleteNextHop" << std::endl;
   if (!e.isNextHop(faceId))
     return;
 
   unregisterPrefix(e.GetName(), faceId);
   e.DeleteNextHop(faceId);
-  std::cerr << now_str() << "====> done with RoutingEntry.DeleteNextHop" << std::endl;
   if (e.GetNextHopsSize() == 0) {
-     m_rt.erase(e.GetName());
-     UpdateDigest();
+     std::string name = e.GetName();
+     m_digest.remove(name, e.GetDigestHash());
+     m_digestStrDirty = true;
+     LogChange(name);
+     auto it = m_rt.find(name);
+     m_bucketEntries[MerkleDigest::bucketOf(name)].erase(&*it);
+     m_rt.erase(it);
   } else {
      e.SetLearnedFrom(e.GetNextHopName(e.GetBestFaceId()));
+     RefreshDigest(e);
   }
 }
 
+void RoutingManager::SetNextHopCost(RoutingEntry& e, uint64_t faceId, uint32_t cost) {
+  e.SetNextHopCost(faceId, cost);
+  RefreshDigest(e);
+}
+
+void RoutingManager::SetSeqNum(RoutingEntry& e, uint64_t seqNum) {
+  e.SetSeqNum(seqNum);
+  RefreshDigest(e);
+}
+
+void RoutingManager::IncSeqNum(RoutingEntry& e, uint64_t i) {
+  e.IncSeqNum(i);
+  RefreshDigest(e);
+}
+
 void RoutingManager::DeleteRoute(std::string name, uint64_t nh) {
   // TODO: we may have other faces to this name prefix (multipath).
   // In that case, we should only remove the nexthop
   unregisterPrefix(name, nh);
-  m_rt.erase(name);
-  UpdateDigest();
+  auto it = m_rt.find(name);
+  if (it == m_rt.end())
+    return;
+  m_digest.remove(name, it->second.GetDigestHash());
+  m_digestStrDirty = true;
+  LogChange(name);
+  m_bucketEntries[MerkleDigest::bucketOf(name)].erase(&*it);
+  m_rt.erase(it);
 }
 
 void RoutingManager::insert(RoutingEntry& e) {
-  m_rt[e.GetName()] = e;
-  UpdateDigest();
+  store(e);
+}
+
+void RoutingManager::store(RoutingEntry& e) {
+  auto stored = LookupRoute(e.GetName());
+  if (stored == nullptr) {
+    auto it = m_rt.emplace(e.GetName(), e).first;
+    stored = &it->second;
+    m_bucketEntries[MerkleDigest::bucketOf(it->first)].insert(&*it);
+  } else {
+    m_digest.remove(stored->GetName(), stored->GetDigestHash());
+    if (stored != &e)
+      *stored = e;
+  }
+  stored->SetDigestHash(IncrementalDigest::hashEntry(stored->GetName(), stored->GetSeqNum(), stored->GetNextHopsSize()));
+  m_digest.add(stored->GetName(), stored->GetDigestHash());
+  m_digestStrDirty = true;
+  LogChange(stored->GetName());
+}
+
+/* e must be the entry stored on m_rt (e.g., returned by LookupRoute) */
+void RoutingManager::RefreshDigest(RoutingEntry& e) {
+  m_digest.remove(e.GetName(), e.GetDigestHash());
+  e.SetDigestHash(IncrementalDigest::hashEntry(e.GetName(), e.GetSeqNum(), e.GetNextHopsSize()));
+  m_digest.add(e.GetName(), e.GetDigestHash());
+  m_digestStrDirty = true;
+  LogChange(e.GetName());
+}
+
+void RoutingManager::LogChange(const std::string& name) {
+  uint32_t version = m_version + 1;
+  if (!m_changeLog.empty() && m_changeLog.back().first == version && m_changeLog.back().second == name)
+    return;
+  m_changeLog.emplace_back(version, name);
+  while (m_changeLog.size() > kChangeLogMaxSize) {
+    m_changeLogFloor = m_changeLog.front().first;
+    m_changeLog.pop_front();
+  }
+}
+
+bool RoutingManager::GetChangesSince(uint32_t version, std::vector<std::string>& names) {
+  if (version < m_changeLogFloor || version > m_version)
+    return false;
+  std::set<std::string> seen;
+  for (auto it = m_changeLog.rbegin(); it != m_changeLog.rend() && it->first > version; ++it) {
+    if (seen.insert(it->second).second)
+      names.push_back(it->second);
+  }
+  return true;
 }
 
+/* Rebuild the digest from scratch. Changes are tracked incrementally, so
+ * this is only needed to recover from entries changed behind our back. */
 void RoutingManager::UpdateDigest() {
-  std::stringstream rt_str, out;
+  m_digest.clear();
+  for (auto& entries : m_bucketEntries)
+    entries.clear();
+  for (auto it = m_rt.begin(); it != m_rt.end(); ++it) {
+    m_bucketEntries[MerkleDigest::bucketOf(it->first)].insert(&*it);
+    it->second.SetDigestHash(IncrementalDigest::hashEntry(it->first, it->second.GetSeqNum(), it->second.GetNextHopsSize()));
+    m_digest.add(it->first, it->second.GetDigestHash());
+  }
+  m_digestStrDirty = true;
+}
+
+IncrementalDigest::Hash IncrementalDigest::hashEntry(const std::string& name, uint64_t seqNum, size_t nextHopsSize) {
   boost::uuids::detail::sha1 sha1;
   unsigned int hash[5];
-  for (auto it = m_rt.begin(); it != m_rt.end(); ++it)
-    rt_str << it->first << it->second.GetSeqNum() << it->second.GetNextHopsSize();
-  sha1.process_bytes(rt_str.str().c_str(), rt_str.str().size());
+  /* fixed-width big-endian fields after a length-prefixed name, so that
+   * distinct entries never hash the same input */
+  uint8_t fields[20];
+  uint64_t nameSize = name.size();
+  uint32_t size = static_cast<uint32_t>(nextHopsSize);
+  for (int i = 0; i < 8; ++i) {
+    fields[i] = nameSize >> (56 - 8 * i);
+    fields[8 + i] = seqNum >> (56 - 8 * i);
+  }
+  for (int i = 0; i < 4; ++i)
+    fields[16 + i] = size >> (24 - 8 * i);
+  sha1.process_bytes(fields, 8);
+  sha1.process_bytes(name.data(), name.size());
+  sha1.process_bytes(fields + 8, 12);
   sha1.get_digest(hash);
-  for(std::size_t i=0; i<sizeof(hash)/sizeof(hash[0]); ++i) {
-      out << std::hex << hash[i];
+  Hash res;
+  for (size_t i = 0; i < res.size(); ++i)
+    res[i] = hash[i];
+  return res;
+}
+
+std::string IncrementalDigest::toString() const {
+  if (m_count == 0)
+    return "0";
+  std::stringstream out;
+  for (size_t i = 0; i < m_sum.size(); ++i)
+    out << std::hex << m_sum[i];
+  return out.str();
+}
+
+size_t IncrementalDigest::toBytes(uint8_t* out) const {
+  if (m_count == 0)
+    return 0;
+  for (size_t i = 0; i < m_sum.size(); ++i) {
+    out[4*i] = m_sum[i] >> 24;
+    out[4*i+1] = m_sum[i] >> 16;
+    out[4*i+2] = m_sum[i] >> 8;
+    out[4*i+3] = m_sum[i];
+  }
+  return kSize;
+}
+
+IncrementalDigest::Bytes IncrementalDigest::toFixedBytes() const {
+  Bytes out;
+  for (size_t i = 0; i < m_sum.size(); ++i) {
+    out[4*i] = m_sum[i] >> 24;
+    out[4*i+1] = m_sum[i] >> 16;
+    out[4*i+2] = m_sum[i] >> 8;
+    out[4*i+3] = m_sum[i];
   }
-  m_digest = out.str();
+  return out;
+}
+
+IncrementalDigest::Hash IncrementalDigest::fromBytes(const uint8_t* in) {
+  Hash h;
+  for (size_t i = 0; i < h.size(); ++i)
+    h[i] = (uint32_t(in[4*i]) << 24) | (uint32_t(in[4*i+1]) << 16) | (uint32_t(in[4*i+2]) << 8) | in[4*i+3];
+  return h;
+}
+
+/* FNV-1a: buckets must be the same on every router, whatever the platform */
+size_t MerkleDigest::bucketOf(const std::string& name) {
+  uint32_t h = 2166136261u;
+  for (unsigned char c : name) {
+    h ^= c;
+    h *= 16777619u;
+  }
+  return h % kBuckets;
+}
+
+void MerkleDigest::clear() {
+  m_root.clear();
+  for (auto& n : m_nodes)
+    n.clear();
+  for (auto& b : m_buckets)
+    b.clear();
+}
+
+void MerkleDigest::add(const std::string& name, const IncrementalDigest::Hash& h) {
+  size_t b = bucketOf(name);
+  m_buckets[b].add(h);
+  m_nodes[b / kFanout].add(h);
+  m_root.add(h);
+}
+
+void MerkleDigest::remove(const std::string& name, const IncrementalDigest::Hash& h) {
+  size_t b = bucketOf(name);
+  m_buckets[b].remove(h);
+  m_nodes[b / kFanout].remove(h);
+  m_root.remove(h);
 }
 
 } // namespace ndvr
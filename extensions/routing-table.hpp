@@ -1,39 +1,186 @@
       #ifndef _ROUTINGTABLE_H_
       #define _ROUTINGTABLE_H_
 
+      #include <algorithm>
+      #include <array>
+      #include <deque>
       #include <map>
+      #include <set>
       #include <ndn-cxx/mgmt/nfd/controller.hpp>
+      #include <boost/container/small_vector.hpp>
+
+      #include "fib-update-queue.hpp"
+      #include "router-id-table.hpp"
 
       namespace ndn {
       namespace ndvr {
 
-     class NextHop{
-        public:
-          NextHop()
-          {
-          }
+      /**
+       * @brief order-independent digest of a set of routing entries
+       *
+       *   Each entry contributes a SHA-1 hash of (name, seqNum, number of
+       *   valid next hops). Contributions are combined by lane-wise addition
+       *   (mod 2^32), so adding, removing or updating an entry costs O(1)
+       *   regardless of the table size, and the result does not depend on
+       *   the iteration order.
+       */
+      class IncrementalDigest {
+      public:
+        typedef std::array<uint32_t, 5> Hash;
+
+        IncrementalDigest()
+        {
+          clear();
+        }
 
-          NextHop(std::vector<std::string> router_ids)
-          :m_router_ids(router_ids)
-          {
-            }
+        void clear() {
+          m_sum.fill(0);
+          m_count = 0;
+        }
 
-          void SetRouterIds(std::vector<std::string> router_ids) {
-            m_router_ids = router_ids;
-          }
+        void add(const Hash& h) {
+          for (size_t i = 0; i < m_sum.size(); ++i)
+            m_sum[i] += h[i];
+          m_count++;
+        }
 
-          std::vector<std::string> GetRouterIds() const {
-            return m_router_ids;
-          }
+        void remove(const Hash& h) {
+          for (size_t i = 0; i < m_sum.size(); ++i)
+            m_sum[i] -= h[i];
+          m_count--;
+        }
+
+        /* "0" stands for the empty set */
+        std::string toString() const;
+
+        /* binary form (big-endian words) as announced by hellos, nothing
+         * for the empty set. Returns the number of bytes written to out */
+        static const size_t kSize = 5 * sizeof(uint32_t);
+        size_t toBytes(uint8_t* out) const;
+
+        /* binary form that is all zeros for the empty set, as exchanged on
+         * Merkle reconciliation */
+        typedef std::array<uint8_t, kSize> Bytes;
+        Bytes toFixedBytes() const;
+        static Hash fromBytes(const uint8_t* in);
+
+        static Hash hashEntry(const std::string& name, uint64_t seqNum, size_t nextHopsSize);
+
+      private:
+        Hash m_sum;
+        size_t m_count;
+      };
+
+      /**
+       * @brief routing table digest organized as a Merkle tree of buckets
+       *
+       *   Entries are spread over kBuckets buckets by a hash of their name,
+       *   and the buckets are the leaves of a two level tree of fanout
+       *   kFanout. Since IncrementalDigest is a sum, each node is just the
+       *   digest of the entries below it, a change updates one node per
+       *   level, and the root is the table digest announced by hellos.
+       *   Neighbors holding a different table descend the nodes whose
+       *   digests differ and fetch only the buckets that differ.
+       */
+      class MerkleDigest {
+      public:
+        static const size_t kFanout = 16;
+        static const size_t kBuckets = kFanout * kFanout;
+
+        static size_t bucketOf(const std::string& name);
+
+        void clear();
+        void add(const std::string& name, const IncrementalDigest::Hash& h);
+        void remove(const std::string& name, const IncrementalDigest::Hash& h);
+
+        const IncrementalDigest& root() const {
+          return m_root;
+        }
+        /* i-th child of the root (i < kFanout) */
+        const IncrementalDigest& node(size_t i) const {
+          return m_nodes[i];
+        }
+        const IncrementalDigest& bucket(size_t b) const {
+          return m_buckets[b];
+        }
+
+      private:
+        IncrementalDigest m_root;
+        std::array<IncrementalDigest, kFanout> m_nodes;
+        std::array<IncrementalDigest, kBuckets> m_buckets;
+      };
+
+      /**
+       * @brief path vector of a route, i.e., the routers it went through
+       *
+       *   Routers are stored as ids from the RouterIdTable, names are only
+       *   needed when encoding the DvInfo or printing. The path also keeps
+       *   the OR of the Bloom masks of its routers, so most membership
+       *   tests are answered by a single AND; the ids are only scanned when
+       *   the signature matches.
+       */
+      class NextHop {
+      public:
+        typedef std::vector<RouterIdTable::Id> RouterIds;
+
+        NextHop()
+        {
+        }
+
+        explicit NextHop(RouterIds router_ids)
+        {
+          SetRouterIds(std::move(router_ids));
+        }
+
+        void SetRouterIds(RouterIds router_ids) {
+          m_router_ids = std::move(router_ids);
+          m_signature = 0;
+          for (auto id : m_router_ids)
+            m_signature |= RouterIdTable::instance().mask(id);
+        }
+
+        const RouterIds& GetRouterIds() const {
+          return m_router_ids;
+        }
+
+        RouterIdTable::Signature GetSignature() const {
+          return m_signature;
+        }
+
+        void AddRouterId(RouterIdTable::Id router_id) {
+          m_router_ids.push_back(router_id);
+          m_signature |= RouterIdTable::instance().mask(router_id);
+        }
+
+        void AddRouterId(const std::string& router_name) {
+          AddRouterId(RouterIdTable::instance().intern(router_name));
+        }
 
-          void AddRouterId(std::string router_id) {
-            m_router_ids.push_back(router_id);
+        bool HasRouterId(RouterIdTable::Id router_id) const {
+          RouterIdTable::Signature mask = RouterIdTable::instance().mask(router_id);
+          if ((m_signature & mask) != mask)
+            return false;
+          return std::find(m_router_ids.begin(), m_router_ids.end(), router_id) != m_router_ids.end();
+        }
+
+        size_t size() const {
+          return m_router_ids.size();
+        }
+
+        std::string toString(const std::string& delim = ",") const {
+          std::string result;
+          for (auto id : m_router_ids) {
+            if (!result.empty())
+              result.append(delim);
+            result.append(RouterIdTable::instance().lookup(id));
           }
-   
-     
-        private:
-          std::vector<std::string> m_router_ids;
-     };
+          return result;
+        }
+
+      private:
+        RouterIds m_router_ids;
+        RouterIdTable::Signature m_signature = 0;
+      };
 
       class RoutingEntry {
       public:
@@ -53,8 +200,8 @@
         RoutingEntry(std::string name, uint64_t seqNum, std::string originator, NextHop nextHops)
           : m_name(name)
           , m_seqNum(seqNum)
-          , m_originator(originator)
-          , m_nextHops2(nextHops)
+          , m_originator(RouterIdTable::instance().intern(originator))
+          , m_nextHops2(std::move(nextHops))
           //, m_cost(cost)
           //, m_bestCost(cost)
         {
@@ -62,11 +209,11 @@
 
         RoutingEntry(std::string name, std::string originator, uint64_t seqNum, uint32_t bestCost, std::string learnedFrom, uint32_t secBestCost)
           : m_name(name)
-          , m_originator(originator)
+          , m_originator(RouterIdTable::instance().intern(originator))
           , m_seqNum(seqNum)
           , m_bestFaceId(0)
           , m_bestCost(bestCost)
-          , m_learnedFrom(learnedFrom)
+          , m_learnedFrom(RouterIdTable::instance().intern(learnedFrom))
           , m_secBestCost(secBestCost)
         {
         }
@@ -88,7 +235,7 @@
           return m_name;
         }
 
-        NextHop GetNextHops2() const {
+        const NextHop& GetNextHops2() const {
           return m_nextHops2;
         }
 
@@ -96,13 +243,12 @@
           m_nextHops2 = nextHops;
         }
 
-        void SetOriginator(std::string originator) {
-          m_originator = originator;
+        void SetOriginator(const std::string& originator) {
+          m_originator = RouterIdTable::instance().intern(originator);
         }
 
-
-        std::string GetOriginator() const {
-          return m_originator;
+        const std::string& GetOriginator() const {
+          return RouterIdTable::instance().lookup(m_originator);
         }
 
         void SetSeqNum(uint64_t seqNum) {
@@ -117,40 +263,44 @@
           return m_seqNum;
         }
 
+        /* Add the next hop or update its cost and neighbor. Unlike a plain
+         * insert, the best/second-best costs and the learnedFrom neighbor
+         * are kept up to date, so they always reflect the next hops */
         void UpsertNextHop(uint64_t faceId, uint32_t cost, std::string neighName) {
-          std::cerr << "====> begin UpsertNextHop faceid=" << faceId << std::endl;
-          //m_nextHops[faceId] = std::make_tuple(cost, neighName);
-          m_nextHops[faceId] = std::make_tuple(cost, neighName);
-          //UpdateBestCost();
-          //if (m_bestFaceId == 0 || cost < m_bestCost) {
-          //  m_bestFaceId = faceId;
-          // * m_bestCost = cost;
-          //}
+          RouterIdTable::Id neighId = RouterIdTable::instance().intern(neighName);
+          auto it = lowerBound(faceId);
+          if (it != m_nextHops.end() && it->faceId == faceId) {
+            it->neighId = neighId;
+            UpdateSlotCost(*it, cost);
+          }
+          else {
+            m_nextHops.insert(it, NextHopSlot{faceId, cost, neighId});
+            if (isValidCost(cost))
+              m_validHops++;
+            OfferBest(faceId, cost);
+          }
+          UpdateLearnedFrom();
         }
 
         void SetNextHopCost(uint64_t faceId, uint32_t cost) {
-          auto it = m_nextHops.find(faceId);
-          if (it == m_nextHops.end())
+          NextHopSlot* slot = findSlot(faceId);
+          if (slot == nullptr)
             return;
-          std::get<0>(it->second) = cost;
           // this will send the infinity cost to neighbors even if we have other routes
-          //if (faceId == m_bestFaceId)
-          //  m_bestCost = cost;
-          UpdateBestCost();
+          UpdateSlotCost(*slot, cost);
+          UpdateLearnedFrom();
         }
 
         uint32_t GetCost(uint64_t faceId) {
-          auto it = m_nextHops.find(faceId);
-          if (it != m_nextHops.end())
-             return std::get<0>(it->second);
+          NextHopSlot* slot = findSlot(faceId);
+          if (slot != nullptr)
+             return slot->cost;
           return std::numeric_limits<uint32_t>::max();
         }
 
-        std::string GetNextHopName(uint64_t faceId) {
-          auto it = m_nextHops.find(faceId);
-          if (it != m_nextHops.end())
-             return std::get<1>(it->second);
-          return "";
+        const std::string& GetNextHopName(uint64_t faceId) {
+          NextHopSlot* slot = findSlot(faceId);
+          return RouterIdTable::instance().lookup(slot != nullptr ? slot->neighId : 0);
         }
 
         uint32_t GetBestCost() {
@@ -166,54 +316,43 @@
         }
 
         void DeleteNextHop(uint64_t faceId) {
-          std::cerr << "====> begin DeleteNextHop" << std::endl;
-          m_nextHops.erase(faceId);
-          UpdateBestCost();
-        }
-
+          auto it = lowerBound(faceId);
+          if (it == m_nextHops.end() || it->faceId != faceId)
+            return;
+          uint32_t cost = it->cost;
+          if (isValidCost(cost))
+            m_validHops--;
+          m_nextHops.erase(it);
+          if (isBestOrSecond(faceId, cost))
+            UpdateBestCost();
+          UpdateLearnedFrom();
+        }
+
+        /* Full recomputation of best/second-best. Only needed when the best
+         * (or second-best) next hop gets worse or goes away, otherwise they
+         * are kept incrementally. Ties go to the lowest faceId. */
         void UpdateBestCost() {
-          std::cerr << "====> begin UpdateBestCost " << m_name << std::endl;
           m_bestFaceId = 0;
           m_bestCost = std::numeric_limits<uint32_t>::max();
           m_secBestCost = std::numeric_limits<uint32_t>::max();
-          for (auto it = m_nextHops.begin(); it != m_nextHops.end(); ++it) {
-            std::cerr << "====> step UpdateBestCost faceid=" << it->first << std::endl;
-            if (std::get<0>(it->second) < m_bestCost) {
-              m_secBestCost = m_bestCost;
-              m_bestCost = std::get<0>(it->second);
-              m_bestFaceId = it->first;
-              std::cerr << "====> new faceId=" << m_bestFaceId << " m_bestCost=" << m_bestCost << " m_secBestCost=" << m_secBestCost << std::endl; 
-            } else if (std::get<0>(it->second) < m_secBestCost) {
-              m_secBestCost = std::get<0>(it->second);
-              std::cerr << "====> new  m_secBestCost=" << m_secBestCost << std::endl; 
-            }
-          }
-          if (m_bestFaceId!=0) {
-            SetLearnedFrom(GetNextHopName(m_bestFaceId));
-            std::cerr << "====> SetLearnedFrom=" << GetNextHopName(m_bestFaceId) << std::endl; 
-          }
-          std::cerr << "====> end UpdateBestCost" << std::endl;
+          for (const auto& slot : m_nextHops)
+            OfferBest(slot.faceId, slot.cost);
         }
 
         size_t GetNextHopsSize() {
-          //we cannot just return the map size, because some next hops are actualy
-          //invalid, i.e. infinity cost
-          //return m_nextHops.size();
-          size_t validHopsSize = 0;
-          for (auto it = m_nextHops.begin(); it != m_nextHops.end(); ++it)
-            if (std::get<0>(it->second) != std::numeric_limits<uint32_t>::max())
-              validHopsSize += 1;
-          return validHopsSize;
+          //we cannot just return the number of next hops, because some next hops
+          //are actualy invalid, i.e. infinity cost
+          return m_validHops;
         }
 
         bool isNextHop(uint64_t faceId) {
-          return m_nextHops.find(faceId) != m_nextHops.end();
+          return findSlot(faceId) != nullptr;
         }
 
         std::string getNextHopsStr() {
           std::string result;
-          for (auto it = m_nextHops.begin(); it != m_nextHops.end(); ++it)
-            result.append("faceid=" + std::to_string(it->first) + " (cost=" + std::to_string(std::get<0>(it->second)) +"), ");
+          for (const auto& slot : m_nextHops)
+            result.append("faceid=" + std::to_string(slot.faceId) + " (cost=" + std::to_string(slot.cost) +"), ");
           return result.substr(0, result.size()-2);
         }
 
@@ -225,12 +364,12 @@
           return m_bestFaceId;
         }
 
-        void SetLearnedFrom(std::string learnedFrom) {
-          m_learnedFrom = learnedFrom;
+        void SetLearnedFrom(const std::string& learnedFrom) {
+          m_learnedFrom = RouterIdTable::instance().intern(learnedFrom);
         }
 
-        std::string GetLearnedFrom() const {
-          return m_learnedFrom;
+        const std::string& GetLearnedFrom() const {
+          return RouterIdTable::instance().lookup(m_learnedFrom);
         }
 
       void SetCost(uint64_t faceId, uint32_t cost) {
@@ -242,24 +381,99 @@
         return m_cost;
       }
 
+      /* contribution of this entry to the routing table digest, only
+       * meaningful while the entry is stored on the RoutingManager */
+      const IncrementalDigest::Hash& GetDigestHash() const {
+        return m_digestHash;
+      }
+
+      void SetDigestHash(const IncrementalDigest::Hash& h) {
+        m_digestHash = h;
+      }
+
+      private:
+        /* nextHops are kept sorted by faceId. The cost is used to rank
+         * reachability to that neighbor. The neighId (see RouterIdTable) is
+         * used together with m_learnedFrom when processing the DvInfo and
+         * avoid local loops (i.e., learn a route from a neighbor who learned
+         * only from ourselves) */
+        struct NextHopSlot {
+          uint64_t faceId;
+          uint32_t cost;
+          RouterIdTable::Id neighId;
+        };
+        /* almost all entries have up to 4 next hops, which are stored inline */
+        typedef boost::container::small_vector<NextHopSlot, 4> NextHopSlots;
+
+        static bool isValidCost(uint32_t cost) {
+          return cost != std::numeric_limits<uint32_t>::max();
+        }
+
+        NextHopSlots::iterator lowerBound(uint64_t faceId) {
+          return std::lower_bound(m_nextHops.begin(), m_nextHops.end(), faceId,
+              [] (const NextHopSlot& slot, uint64_t id) { return slot.faceId < id; });
+        }
+
+        NextHopSlot* findSlot(uint64_t faceId) {
+          auto it = lowerBound(faceId);
+          if (it == m_nextHops.end() || it->faceId != faceId)
+            return nullptr;
+          return &*it;
+        }
+
+        bool isBestOrSecond(uint64_t faceId, uint32_t cost) {
+          return (isValidCost(m_bestCost) && faceId == m_bestFaceId) || cost == m_secBestCost;
+        }
+
+        /* a next hop (other than the current best) was added or got better:
+         * it can only take over the best or the second-best position */
+        void OfferBest(uint64_t faceId, uint32_t cost) {
+          if (cost < m_bestCost || (cost == m_bestCost && isValidCost(cost) && faceId < m_bestFaceId)) {
+            m_secBestCost = m_bestCost;
+            m_bestCost = cost;
+            m_bestFaceId = faceId;
+          } else if (cost < m_secBestCost) {
+            m_secBestCost = cost;
+          }
+        }
+
+        void UpdateSlotCost(NextHopSlot& slot, uint32_t cost) {
+          uint32_t old = slot.cost;
+          if (old == cost)
+            return;
+          slot.cost = cost;
+          if (isValidCost(old) && !isValidCost(cost))
+            m_validHops--;
+          else if (!isValidCost(old) && isValidCost(cost))
+            m_validHops++;
+          if (cost < old && isValidCost(m_bestCost) && slot.faceId == m_bestFaceId)
+            m_bestCost = cost;
+          else if (cost < old)
+            OfferBest(slot.faceId, cost);
+          else if (isBestOrSecond(slot.faceId, old))
+            UpdateBestCost();
+        }
+
+        void UpdateLearnedFrom() {
+          if (m_bestFaceId != 0 && isValidCost(m_bestCost))
+            m_learnedFrom = findSlot(m_bestFaceId)->neighId;
+        }
+
       private:
         NextHop m_nextHops2;
         std::string m_name;
-        std::string m_originator;
-        uint64_t m_seqNum;
-        uint64_t m_bestFaceId;
-        uint32_t m_bestCost;
-        uint32_t m_cost;
-        /* nextHops map is indexed by faceId and has as values a tuple
-         * of <cost, neighName>. The cost is used to rank reachability to
-         * that neighbor. The neighName is used together with m_learnedFrom
-         * when processing the DvInfo and avoid local loops (i.e., learn a
-         * route from a neighbor who learned only from ourselves) 
-         */
-        std::map<uint64_t, std::tuple<uint32_t, std::string>> m_nextHops;
+        RouterIdTable::Id m_originator = 0;
+        uint64_t m_seqNum = 0;
+        uint64_t m_bestFaceId = 0;
+        uint32_t m_bestCost = std::numeric_limits<uint32_t>::max();
+        uint32_t m_cost = 0;
+        NextHopSlots m_nextHops;
+        /* number of next hops whose cost is not infinity */
+        uint32_t m_validHops = 0;
         /* variables used when processing the dvinfo */
-        std::string m_learnedFrom;
-        uint32_t m_secBestCost;
+        RouterIdTable::Id m_learnedFrom = 0;
+        uint32_t m_secBestCost = std::numeric_limits<uint32_t>::max();
+        IncrementalDigest::Hash m_digestHash = {};
       };
 
       /**
@@ -271,25 +485,31 @@
        */
       typedef std::map<std::string, RoutingEntry> RoutingTable;
 
+      /* Maximum number of changes kept to build delta DvInfo replies. Older
+       * changes are dropped and neighbors behind them get the full table */
+      static const size_t kChangeLogMaxSize = 8192;
+
       //class RoutingTable : public std::map<std::string, RoutingEntry> {
       class RoutingManager {
       public:
+        static constexpr time::seconds kReconcileInterval = time::seconds(60);
+        static constexpr time::seconds kAdoptionGrace = time::seconds(30);
+
         /* The fact that the elements in a map are always sorted by its key 
          * is important for us for the digest calculation */
         RoutingTable m_rt;
 
         RoutingManager()
           : m_version(1)
-          , m_digest("0")
         {
         }
 
         RoutingManager(ndn::Face& face, ndn::KeyChain& keyChain)
           : m_version(1)
-          , m_digest("0")
           , m_face(face.getIoService())
         {
           m_controller = new ndn::nfd::Controller(face, keyChain);
+          m_fibQueue.reset(new FibUpdateQueue(face, *m_controller));
           //m_netmon = make_shared<ndn::net::NetworkMonitor>(face.getIoService());
         }
 
@@ -300,14 +520,50 @@
         void DeleteRoute(std::string name, uint64_t nh);
         bool isDirectRoute(std::string n);
         RoutingEntry* LookupRoute(std::string n);
+        RoutingEntry* LongestPrefixMatch(std::string n);
         void UpsertNextHop(RoutingEntry& e, uint64_t faceId, uint32_t cost, std::string neighName);
         void DeleteNextHop(RoutingEntry& e, uint64_t nh);
+        void SetNextHopCost(RoutingEntry& e, uint64_t faceId, uint32_t cost);
+        void SetSeqNum(RoutingEntry& e, uint64_t seqNum);
+        void IncSeqNum(RoutingEntry& e, uint64_t i);
         void insert(RoutingEntry& e);
         void UpdateDigest();
-        void unregisterPrefix(const std::string name, const uint64_t faceId);
-        void registerPrefix(std::string name, uint64_t faceId, uint32_t cost, uint8_t retry = 0);
-        uint64_t createFace(std::string faceUri);
+        void unregisterPrefix(const std::string name, const uint64_t faceId, FibUpdateQueue::Priority priority = FibUpdateQueue::PRIORITY_NORMAL);
+        void registerPrefix(std::string name, uint64_t faceId, uint32_t cost, FibUpdateQueue::Priority priority = FibUpdateQueue::PRIORITY_NORMAL,
+                            std::function<void()> onInstalled = nullptr);
+        void onFaceDestroyed(uint64_t faceId);
+
+        /* soft-state routes (see FibUpdateQueue::RefreshFace) */
+        void RefreshFace(uint64_t faceId, time::milliseconds expiration) {
+          m_fibQueue->RefreshFace(faceId, expiration);
+        }
+        void ExpireFace(uint64_t faceId) {
+          m_fibQueue->ExpireFace(faceId);
+        }
+        void AddPermanentPrefix(const Name& prefix) {
+          m_fibQueue->AddPermanentPrefix(prefix);
+        }
+        void StartReconciler();
+        void cleanup();
+
+        /* program next hops straight on the NFD FIB instead of the RIB */
+        void SetDirectFib(bool directFib) {
+          m_fibQueue->SetDirectFib(directFib);
+        }
+        bool IsDirectFib() const {
+          return m_fibQueue->IsDirectFib();
+        }
+        /* direct FIB mode: file recording the next hops we installed */
+        void SetFibStateFile(const std::string& filename) {
+          m_fibQueue->SetStateFile(filename);
+        }
+        /* canonize faceUri and create the face on NFD, reporting the faceId
+         * (or why it failed) asynchronously. An existing face is reused */
+        void createFace(const std::string& faceUri, std::function<void(uint64_t)> onCreated,
+                        std::function<void(const std::string&)> onFailure);
         void enableLocalFields();
+        /* asks NFD the link type of faceId (LINK_TYPE_NONE on failure) */
+        void queryFaceLinkType(uint64_t faceId, std::function<void(ndn::nfd::LinkType)> cb);
         void setMulticastStrategy(std::string name);
 
         uint32_t GetVersion() {
@@ -315,14 +571,44 @@
         }
         void IncVersion() {
           m_version++;
-          UpdateDigest();
         }
 
-        std::string GetDigest() const {
+        /* Names changed (updated or removed) after @p version. Returns false
+         * when the change log no longer covers that version */
+        bool GetChangesSince(uint32_t version, std::vector<std::string>& names);
+
+        /* writes the binary digest (up to IncrementalDigest::kSize bytes) */
+        size_t GetDigestBytes(uint8_t* out) const {
+          return m_digest.root().toBytes(out);
+        }
+
+        const MerkleDigest& GetMerkleDigest() const {
           return m_digest;
         }
-        void SetDigest(std::string s) {
-          m_digest = s;
+
+        /* entries of m_rt that fall in a Merkle bucket, sorted by name.
+         * They point to the nodes of the map, so names are not copied */
+        struct ByName {
+          bool operator()(const RoutingTable::value_type* a, const RoutingTable::value_type* b) const {
+            return a->first < b->first;
+          }
+        };
+        typedef std::set<RoutingTable::value_type*, ByName> BucketEntries;
+
+        /* entries of a Merkle bucket, so that a bucket is encoded or
+         * reconciled without going through the whole table */
+        const BucketEntries& GetBucketEntries(size_t bucket) const {
+          return m_bucketEntries[bucket];
+        }
+
+        /* The digest is maintained incrementally on every change, only its
+         * string form is built on demand */
+        std::string GetDigest() const {
+          if (m_digestStrDirty) {
+            m_digestStr = m_digest.root().toString();
+            m_digestStrDirty = false;
+          }
+          return m_digestStr;
         }
 
         // just forward some methods
@@ -331,19 +617,39 @@
         decltype(m_rt.size()) size() { return m_rt.size(); }
 
       private:
-        /*! \brief Log registration success.
+        /*! \brief Store a copy of @p e, replacing the existing entry (if any)
+         *  and updating the digest.
+         */
+        void store(RoutingEntry& e);
+
+        /*! \brief Recompute the digest contribution of a stored entry after
+         *  it was changed in place.
+         */
+        void RefreshDigest(RoutingEntry& e);
+
+        /*! \brief Record that @p name changed in the version being built
+         *  (i.e., the one to be announced on the next IncVersion).
          */
-        void onRegistrationSuccess(const ndn::nfd::ControlParameters& param);
+        void LogChange(const std::string& name);
 
-        /*! \brief Retry a prefix (next-hop) registration up to three (3) times.
+        /*! \brief Routes towards other routers (i.e., router prefixes) are
+         *  programmed ahead of the bulk of name prefixes.
          */
-        void onRegistrationFailure(const ndn::nfd::ControlResponse& resp, const ndn::nfd::ControlParameters& param, uint8_t retry);
+        static FibUpdateQueue::Priority PriorityOf(const std::string& name);
 
       private:
         uint32_t m_version;
-        std::string m_digest;
+        MerkleDigest m_digest;
+        std::array<BucketEntries, MerkleDigest::kBuckets> m_bucketEntries;
+        mutable std::string m_digestStr = "0";
+        mutable bool m_digestStrDirty = false;
+        /* (version, name) of the latest changes, oldest first */
+        std::deque<std::pair<uint32_t, std::string>> m_changeLog;
+        /* newest version whose changes were (partially) dropped from the log */
+        uint32_t m_changeLogFloor = 0;
         ndn::Face m_face;
         ndn::nfd::Controller *m_controller;
+        std::unique_ptr<FibUpdateQueue> m_fibQueue;
         //shared_ptr<ndn::net::NetworkMonitor> m_netmon;
       };
 
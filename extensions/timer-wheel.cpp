@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "timer-wheel.hpp"
+
+#include <algorithm>
+
+namespace ndn {
+namespace ndvr {
+
+void
+TimerWheel::Timer::cancel()
+{
+  if (isPending())
+    m_wheel->unlink(*this);
+  m_callback = nullptr;
+}
+
+TimerWheel::TimerWheel(ndn::Scheduler& scheduler, time::milliseconds tick, size_t nSlots)
+  : m_scheduler(scheduler)
+  , m_tick(tick)
+  , m_nSlots(nSlots)
+  , m_slots(new Link[nSlots])
+  , m_start(time::steady_clock::now())
+{
+  for (size_t i = 0; i < m_nSlots; ++i)
+    m_slots[i].prev = m_slots[i].next = &m_slots[i];
+}
+
+TimerWheel::~TimerWheel()
+{
+  m_driver.cancel();
+  for (size_t i = 0; i < m_nSlots; ++i)
+    while (m_slots[i].next != &m_slots[i])
+      unlink(*static_cast<Timer*>(m_slots[i].next));
+}
+
+uint64_t
+TimerWheel::currentTick() const
+{
+  return (time::steady_clock::now() - m_start) / m_tick;
+}
+
+void
+TimerWheel::link(Link& head, Timer& timer)
+{
+  timer.prev = head.prev;
+  timer.next = &head;
+  head.prev->next = &timer;
+  head.prev = &timer;
+  timer.m_wheel = this;
+  m_size++;
+}
+
+void
+TimerWheel::unlink(Timer& timer)
+{
+  timer.prev->next = timer.next;
+  timer.next->prev = timer.prev;
+  timer.prev = timer.next = nullptr;
+  m_size--;
+}
+
+void
+TimerWheel::schedule(Timer& timer, time::nanoseconds after, std::function<void()> callback)
+{
+  timer.cancel();
+  /* nothing is waiting, the cursor may have been idle for a while */
+  if (m_size == 0)
+    m_cursor = std::max(m_cursor, currentTick());
+
+  uint64_t ticks = after > time::nanoseconds::zero() ? (after + m_tick - time::nanoseconds(1)) / m_tick : 0;
+  timer.m_expiry = std::max(currentTick() + ticks, m_cursor + 1);
+  timer.m_callback = std::move(callback);
+  link(m_slots[timer.m_expiry % m_nSlots], timer);
+  arm(timer.m_expiry);
+}
+
+void
+TimerWheel::arm(uint64_t tick)
+{
+  if (m_driver && m_driverTick <= tick)
+    return;
+  m_driver.cancel();
+  m_driverTick = tick;
+  auto delay = m_start + m_tick * static_cast<int64_t>(tick) - time::steady_clock::now();
+  m_driver = m_scheduler.schedule(std::max(time::duration_cast<time::nanoseconds>(delay), time::nanoseconds::zero()),
+                                  [this] { onTick(); });
+}
+
+void
+TimerWheel::onTick()
+{
+  /* collect the timers due up to now (the driver may run late) */
+  Link batch;
+  batch.prev = batch.next = &batch;
+  uint64_t now = currentTick();
+  for (; m_cursor < now; ++m_cursor) {
+    Link& head = m_slots[(m_cursor + 1) % m_nSlots];
+    for (Link* l = head.next; l != &head; ) {
+      Link* next = l->next;
+      Timer* timer = static_cast<Timer*>(l);
+      if (timer->m_expiry <= m_cursor + 1) {
+        l->prev->next = l->next;
+        l->next->prev = l->prev;
+        l->prev = batch.prev;
+        l->next = &batch;
+        batch.prev->next = l;
+        batch.prev = l;
+      }
+      l = next;
+    }
+  }
+
+  /* callbacks may cancel or reschedule any timer, including the ones still
+   * in the batch */
+  while (batch.next != &batch) {
+    Timer* timer = static_cast<Timer*>(batch.next);
+    unlink(*timer);
+    auto callback = std::move(timer->m_callback);
+    timer->m_callback = nullptr;
+    callback();
+  }
+
+  if (m_size == 0)
+    return;
+  /* the next slot holding timers */
+  for (uint64_t tick = m_cursor + 1; tick <= m_cursor + m_nSlots; ++tick) {
+    Link& head = m_slots[tick % m_nSlots];
+    if (head.next != &head) {
+      arm(tick);
+      return;
+    }
+  }
+}
+
+} // namespace ndvr
+} // namespace ndn
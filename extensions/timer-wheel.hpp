@@ -0,0 +1,133 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_TIMER_WHEEL_HPP
+#define NDVR_TIMER_WHEEL_HPP
+
+#include <functional>
+#include <memory>
+
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief hashed timer wheel for the per-neighbor timers
+ *
+ * Every hello reschedules the neighbor removal, and DvInfo backoffs and
+ * liveness probes are rescheduled just as often. With ndn::Scheduler each
+ * reschedule is a cancel plus an insert on its timer heap. Here timers are
+ * intrusive list nodes owned by the caller (e.g., the NeighborEntry) hashed
+ * into nSlots slots of one tick each, so (re)scheduling and cancelling are
+ * O(1). Timers further away than a wheel revolution just stay in their slot
+ * until their tick comes.
+ *
+ * The wheel is driven by a single ndn::Scheduler event, armed for the next
+ * slot holding timers, and the timers due on each tick expire in one batch.
+ * Deadlines are rounded up to the tick.
+ */
+class TimerWheel
+{
+private:
+  struct Link {
+    Link* prev = nullptr;
+    Link* next = nullptr;
+  };
+
+public:
+  /** @brief a timer, cancelled when destroyed. Copies are not scheduled */
+  class Timer : private Link
+  {
+  public:
+    Timer() = default;
+
+    Timer(const Timer&)
+    {
+    }
+
+    Timer&
+    operator=(const Timer&)
+    {
+      return *this;
+    }
+
+    ~Timer()
+    {
+      cancel();
+    }
+
+    void
+    cancel();
+
+    bool
+    isPending() const
+    {
+      return next != nullptr;
+    }
+
+    explicit
+    operator bool() const
+    {
+      return isPending();
+    }
+
+  private:
+    friend class TimerWheel;
+    TimerWheel* m_wheel = nullptr;
+    /* tick on which the timer expires */
+    uint64_t m_expiry = 0;
+    std::function<void()> m_callback;
+  };
+
+  TimerWheel(ndn::Scheduler& scheduler, time::milliseconds tick = time::milliseconds(10),
+             size_t nSlots = 256);
+
+  ~TimerWheel();
+
+  /** @brief (re)schedule @p timer to call @p callback @p after from now */
+  void
+  schedule(Timer& timer, time::nanoseconds after, std::function<void()> callback);
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+private:
+  uint64_t
+  currentTick() const;
+
+  void
+  link(Link& head, Timer& timer);
+
+  void
+  unlink(Timer& timer);
+
+  /*! \brief Arm the driver event for @p tick, unless it is armed earlier.
+   */
+  void
+  arm(uint64_t tick);
+
+  void
+  onTick();
+
+private:
+  ndn::Scheduler& m_scheduler;
+  time::nanoseconds m_tick;
+  size_t m_nSlots;
+  std::unique_ptr<Link[]> m_slots;
+  size_t m_size = 0;
+
+  time::steady_clock::TimePoint m_start;
+  /* last tick processed */
+  uint64_t m_cursor = 0;
+  scheduler::EventId m_driver;
+  uint64_t m_driverTick = 0;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_TIMER_WHEEL_HPP
@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "trickle-timer.hpp"
+
+namespace ndn {
+namespace ndvr {
+
+TrickleTimer::TrickleTimer(ndn::Scheduler& scheduler, std::function<void()> onFire,
+                           time::milliseconds imin, time::milliseconds imax, uint32_t k)
+  : m_scheduler(scheduler)
+  , m_onFire(std::move(onFire))
+  , m_imin(imin)
+  , m_imax(std::max(imax, imin))
+  , m_k(k)
+  , m_interval(imin)
+  , m_rengine(std::random_device{}())
+{
+}
+
+void
+TrickleTimer::Start()
+{
+  m_running = true;
+  m_interval = m_imin;
+  m_suppressed = 0;
+  startInterval();
+}
+
+void
+TrickleTimer::Stop()
+{
+  m_running = false;
+  m_fireEvent.cancel();
+  m_intervalEvent.cancel();
+}
+
+void
+TrickleTimer::Reset()
+{
+  if (!m_running)
+    return;
+  if (m_interval == m_imin && !m_fired) {
+    m_counter = 0;
+    return;
+  }
+  m_interval = m_imin;
+  startInterval();
+}
+
+void
+TrickleTimer::startInterval()
+{
+  m_fireEvent.cancel();
+  m_intervalEvent.cancel();
+  m_counter = 0;
+  m_fired = false;
+
+  /* t is picked from [I/2, I) */
+  std::uniform_int_distribution<time::milliseconds::rep> dist(m_interval.count() / 2, m_interval.count() - 1);
+  m_fireEvent = m_scheduler.schedule(time::milliseconds(dist(m_rengine)), [this] { onTimer(); });
+  m_intervalEvent = m_scheduler.schedule(m_interval, [this] {
+    m_interval = std::min(m_interval * 2, m_imax);
+    startInterval();
+  });
+}
+
+void
+TrickleTimer::onTimer()
+{
+  m_fired = true;
+  if (m_k > 0 && m_counter >= m_k && m_suppressed < kMaxSuppressed) {
+    m_suppressed++;
+    return;
+  }
+  m_suppressed = 0;
+  m_onFire();
+}
+
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,124 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_TRICKLE_TIMER_HPP
+#define NDVR_TRICKLE_TIMER_HPP
+
+#include <algorithm>
+#include <functional>
+#include <random>
+
+#include <ndn-cxx/util/scheduler.hpp>
+#include <ndn-cxx/util/time.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief Trickle timer (RFC 6206)
+ *
+ * Each interval I starts with I/2 of silence and then fires at a random time
+ * t in [I/2, I), unless k or more consistent messages were heard in the
+ * interval (suppression). At the end of the interval I doubles, up to Imax.
+ * An inconsistency (Reset) brings I back to Imin, so changes go out within
+ * Imin while a stable network only transmits once every Imax or less.
+ *
+ * Since our transmissions also tell the neighbors we are alive, the timer
+ * never suppresses two intervals in a row (kMaxSuppressed). Hence there are
+ * at most 2.5 * Imax between two transmissions (see GetMaxSilence).
+ */
+class TrickleTimer
+{
+public:
+  TrickleTimer(ndn::Scheduler& scheduler, std::function<void()> onFire,
+               time::milliseconds imin = time::seconds(1),
+               time::milliseconds imax = time::seconds(2),
+               uint32_t k = 1);
+
+  /** @brief start (or restart) the timer with I = Imin */
+  void
+  Start();
+
+  void
+  Stop();
+
+  /** @brief an inconsistency was detected: restart with I = Imin. If I
+   * already is Imin and the transmission of the interval is still to come,
+   * it is kept (and no longer suppressed) rather than pushed back, so
+   * repeated resets can not starve it */
+  void
+  Reset();
+
+  /** @brief a consistent message was heard, it counts for suppression */
+  void
+  HearConsistent()
+  {
+    m_counter++;
+  }
+
+  bool
+  IsRunning() const
+  {
+    return m_running;
+  }
+
+  time::milliseconds
+  GetInterval() const
+  {
+    return m_interval;
+  }
+
+  void
+  SetImin(time::milliseconds imin)
+  {
+    m_imin = imin;
+    m_imax = std::max(m_imax, imin);
+  }
+
+  void
+  SetImax(time::milliseconds imax)
+  {
+    m_imax = std::max(imax, m_imin);
+  }
+
+  time::milliseconds
+  GetImax() const
+  {
+    return m_imax;
+  }
+
+  /** @brief longest possible time between two transmissions */
+  time::milliseconds
+  GetMaxSilence() const
+  {
+    return m_imax * (2 * kMaxSuppressed + 3) / 2;
+  }
+
+private:
+  void
+  startInterval();
+
+  void
+  onTimer();
+
+private:
+  ndn::Scheduler& m_scheduler;
+  std::function<void()> m_onFire;
+  time::milliseconds m_imin;
+  time::milliseconds m_imax;
+  uint32_t m_k;
+  static const uint32_t kMaxSuppressed = 1;
+
+  time::milliseconds m_interval;
+  uint32_t m_counter = 0;
+  uint32_t m_suppressed = 0;
+  bool m_running = false;
+  bool m_fired = false;  /* the transmission time of the interval has passed */
+  scheduler::EventId m_fireEvent;
+  scheduler::EventId m_intervalEvent;
+  std::mt19937 m_rengine;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_TRICKLE_TIMER_HPP
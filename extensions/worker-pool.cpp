@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "worker-pool.hpp"
+
+namespace ndn {
+namespace ndvr {
+
+WorkerPool::WorkerPool(boost::asio::io_service& mainIo, size_t nThreads)
+  : m_mainIo(mainIo)
+  , m_work(new boost::asio::io_service::work(m_workIo))
+  , m_results(128)
+  , m_drainPosted(false)
+  , m_alive(std::make_shared<bool>(true))
+{
+  for (size_t i = 0; i < nThreads; i++)
+    m_threads.emplace_back([this] { m_workIo.run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+  m_work.reset();
+  m_workIo.stop();
+  for (auto& thread : m_threads)
+    thread.join();
+  Result* result;
+  while (m_results.pop(result))
+    delete result;
+}
+
+void
+WorkerPool::submit(const std::string& key, Job job)
+{
+  uint64_t seq = m_orderings[key].nextSubmit++;
+  std::weak_ptr<bool> alive = m_alive;
+  m_workIo.post([this, key, seq, alive, job = std::move(job)] {
+    Completion completion;
+    try {
+      completion = job();
+    }
+    catch (const std::exception&) {
+      /* nothing to complete, but the key's order goes on */
+    }
+    m_results.push(new Result{key, seq, std::move(completion)});
+    /* one drain handler takes all the results queued until it runs */
+    if (!m_drainPosted.exchange(true))
+      m_mainIo.post([this, alive] {
+        if (!alive.expired())
+          drain();
+      });
+  });
+}
+
+void
+WorkerPool::drain()
+{
+  /* reset before popping: results pushed from now on post a new handler */
+  m_drainPosted = false;
+  Result* result;
+  while (m_results.pop(result)) {
+    std::unique_ptr<Result> owned(result);
+    auto it = m_orderings.find(owned->key);
+    if (it == m_orderings.end())
+      continue;
+    auto& ordering = it->second;
+    ordering.ready[owned->seq] = std::move(owned->completion);
+    while (!ordering.ready.empty() && ordering.ready.begin()->first == ordering.nextComplete) {
+      Completion completion = std::move(ordering.ready.begin()->second);
+      ordering.ready.erase(ordering.ready.begin());
+      ordering.nextComplete++;
+      if (completion)
+        completion();
+    }
+    if (ordering.nextComplete == ordering.nextSubmit)
+      m_orderings.erase(it);
+  }
+}
+
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,88 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_WORKER_POOL_HPP
+#define NDVR_WORKER_POOL_HPP
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/lockfree/queue.hpp>
+
+namespace ndn {
+namespace ndvr {
+
+/**
+ * @brief worker threads for the CPU heavy parts of DvInfo processing
+ *
+ * A job runs on one of the worker threads and returns a completion, which
+ * runs back on the main thread (the one running the Face io_service), so
+ * the routing table and the rest of the router state are only touched by
+ * the main thread. Jobs must only use the data they captured.
+ *
+ * Completions are handed to the main thread through a lock-free queue,
+ * drained by a single handler posted on the main io_service when the queue
+ * goes from empty to non-empty. The completions of jobs with the same key
+ * (e.g., the neighbor) run in the order the jobs were submitted, even if
+ * they finish out of order.
+ */
+class WorkerPool
+{
+public:
+  typedef std::function<void()> Completion;
+  typedef std::function<Completion()> Job;
+
+  WorkerPool(boost::asio::io_service& mainIo, size_t nThreads);
+
+  /** @brief wait for the running jobs, completions not run yet are dropped */
+  ~WorkerPool();
+
+  /** @brief run @p job on a worker thread (main thread only) */
+  void
+  submit(const std::string& key, Job job);
+
+  size_t
+  size() const
+  {
+    return m_threads.size();
+  }
+
+private:
+  struct Result {
+    std::string key;
+    uint64_t seq;
+    Completion completion;
+  };
+
+  /* completions of a key waiting for the ones submitted before */
+  struct Ordering {
+    uint64_t nextSubmit = 0;
+    uint64_t nextComplete = 0;
+    std::map<uint64_t, Completion> ready;
+  };
+
+  /* runs on the main thread */
+  void
+  drain();
+
+private:
+  boost::asio::io_service& m_mainIo;
+  boost::asio::io_service m_workIo;
+  std::unique_ptr<boost::asio::io_service::work> m_work;
+  std::vector<std::thread> m_threads;
+  boost::lockfree::queue<Result*> m_results;
+  std::atomic<bool> m_drainPosted;
+  std::map<std::string, Ordering> m_orderings;  /* main thread only */
+  /* drain handlers still posted when the pool is gone do nothing */
+  std::shared_ptr<bool> m_alive;
+};
+
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_WORKER_POOL_HPP
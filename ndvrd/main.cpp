@@ -9,13 +9,23 @@ int main(int32_t argc, char** argv)
   std::string networkName;
   std::string routerName;
   int helloInterval = 0;
+  int maxHelloInterval = 0;
   std::string validationConfig;
   std::vector<std::string> namePrefixes;
   std::vector<std::string> faces;  // faces we will be listen (existing faceId or localUri to be created)
   std::vector<std::string> monitorFaces;  // list of face URIs we will monitor for nfd/faces/events
+  bool directFib = false;  // program the FIB directly instead of registering routes on the RIB
+  std::string fibStateFile;  // next hops installed in direct FIB mode (empty keeps the default)
+  int probeInterval = -1;  // liveness probe interval in ms (-1 keeps the default, 0 disables probes)
+  int probeDetectMult = 0;  // missed probes before declaring a neighbor dead (0 keeps the default)
+  int dvInfoMtu = 0;  // maximum size of a DvInfo segment in bytes (0 keeps the default)
+  bool compactDvInfo = false;  // send compact DvInfo to neighbors accepting it
+  bool dvInfoPush = false;  // push DvInfo changes to the neighbors
+  bool merkleSync = false;  // reconcile with neighbors through their Merkle tree of buckets
+  int workerThreads = 0;  // threads for DvInfo validation and decoding (0 keeps it on the main thread)
 
   int32_t opt;
-  while ((opt = getopt(argc, argv, "dv:c:n:r:i:p:f:m:h")) != -1) {
+  while ((opt = getopt(argc, argv, "dv:c:n:r:i:I:p:f:m:b:k:u:w:S:zPMFh")) != -1) {
     switch (opt) {
       case 'v':
         validationConfig = optarg;
@@ -29,6 +39,9 @@ int main(int32_t argc, char** argv)
       case 'i':
         helloInterval = strtol(optarg, NULL, 10);
         break;
+      case 'I':
+        maxHelloInterval = strtol(optarg, NULL, 10);
+        break;
       case 'p':
         namePrefixes.push_back(optarg);
         break;
@@ -38,6 +51,33 @@ int main(int32_t argc, char** argv)
       case 'm':
         monitorFaces.push_back(optarg);
         break;
+      case 'b':
+        probeInterval = strtol(optarg, NULL, 10);
+        break;
+      case 'k':
+        probeDetectMult = strtol(optarg, NULL, 10);
+        break;
+      case 'u':
+        dvInfoMtu = strtol(optarg, NULL, 10);
+        break;
+      case 'w':
+        workerThreads = strtol(optarg, NULL, 10);
+        break;
+      case 'z':
+        compactDvInfo = true;
+        break;
+      case 'P':
+        dvInfoPush = true;
+        break;
+      case 'M':
+        merkleSync = true;
+        break;
+      case 'F':
+        directFib = true;
+        break;
+      case 'S':
+        fibStateFile = optarg;
+        break;
       case 'h':
       default:
         ndn::ndvr::NdvrRunner::printUsage(programName);
@@ -65,7 +105,7 @@ int main(int32_t argc, char** argv)
     return EXIT_FAILURE;
   }
 
-  ndn::ndvr::NdvrRunner runner(networkName, routerName, helloInterval, validationConfig, namePrefixes, faces, monitorFaces);
+  ndn::ndvr::NdvrRunner runner(networkName, routerName, helloInterval, maxHelloInterval, validationConfig, namePrefixes, faces, monitorFaces, directFib, fibStateFile, probeInterval, probeDetectMult, dvInfoMtu, compactDvInfo, dvInfoPush, merkleSync, workerThreads);
 
   try {
     runner.run();
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "fib-update-queue.hpp"
+
+#include "unit-test-time-fixture.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/util/dummy-client-face.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+namespace ndn {
+namespace ndvr {
+namespace tests {
+
+class FibUpdateQueueFixture : public UnitTestTimeFixture
+{
+public:
+  FibUpdateQueueFixture()
+    : m_keyChain("pib-memory:", "tpm-memory:")
+    , m_face(m_io, m_keyChain)
+    , m_controller(m_face, m_keyChain)
+    , m_queue(m_face, m_controller)
+  {
+    m_keyChain.createIdentity("/ndvr/test");
+  }
+
+  /* parameters of the commands sent so far under @p verb, e.g.,
+   * /localhost/nfd/rib/unregister */
+  std::vector<nfd::ControlParameters>
+  sentCommands(const Name& verb)
+  {
+    std::vector<nfd::ControlParameters> commands;
+    for (const auto& interest : m_face.sentInterests)
+      if (verb.isPrefixOf(interest.getName()))
+        commands.emplace_back(interest.getName().at(verb.size()).blockFromValue());
+    return commands;
+  }
+
+  /* command Interests sent so far under @p verb */
+  std::vector<Interest>
+  sentCommandInterests(const Name& verb)
+  {
+    std::vector<Interest> interests;
+    for (const auto& interest : m_face.sentInterests)
+      if (verb.isPrefixOf(interest.getName()))
+        interests.push_back(interest);
+    return interests;
+  }
+
+  /* answers the command @p interest with @p code, echoing its parameters
+   * on success */
+  void
+  reply(const Interest& interest, uint32_t code)
+  {
+    nfd::ControlResponse response(code, code == 200 ? "OK" : "Failed");
+    if (code == 200)
+      response.setBody(interest.getName().at(4).blockFromValue());
+    auto data = std::make_shared<Data>(interest.getName());
+    data->setContent(response.wireEncode());
+    m_keyChain.sign(*data);
+    m_face.receive(*data);
+  }
+
+protected:
+  KeyChain m_keyChain;
+  util::DummyClientFace m_face;
+  nfd::Controller m_controller;
+  FibUpdateQueue m_queue;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestFibUpdateQueue, FibUpdateQueueFixture)
+
+BOOST_AUTO_TEST_CASE(ExpireFaceUnregisters)
+{
+  const Name prefix("/ndn/site-1");
+  const Name protocolPrefix("/localhop/ndvr/dvinfo");
+  m_queue.AddPermanentPrefix("/localhop/ndvr");
+  m_queue.RefreshFace(5, time::seconds(30));
+  /* routes NFD already has, so registering them sends nothing */
+  m_queue.Adopt(prefix, 5, 2);
+  m_queue.Adopt(protocolPrefix, 5, 0);
+  m_queue.Register(prefix, 5, 2);
+  m_queue.Register(protocolPrefix, 5, 0);
+  advanceClocks(time::milliseconds(10), 10);
+  BOOST_CHECK_EQUAL(m_face.sentInterests.size(), 0);
+
+  /* the neighbor on face 5 is gone */
+  m_queue.ExpireFace(5);
+  advanceClocks(time::milliseconds(10), 10);
+
+  auto unregistered = sentCommands("/localhost/nfd/rib/unregister");
+  BOOST_REQUIRE_EQUAL(unregistered.size(), 1);
+  BOOST_CHECK_EQUAL(unregistered[0].getName(), prefix);
+  BOOST_CHECK_EQUAL(unregistered[0].getFaceId(), 5);
+  BOOST_CHECK_EQUAL(unregistered[0].getOrigin(), FibUpdateQueue::ROUTE_ORIGIN_NDVR);
+}
+
+BOOST_AUTO_TEST_CASE(UnregisterRemovesFibNextHop)
+{
+  const Name prefix("/ndn/site-1");
+  m_queue.SetDirectFib(true);
+  m_queue.Adopt(prefix, 7, 3);
+  m_queue.Register(prefix, 7, 3);
+  m_queue.Unregister(prefix, 7);
+  advanceClocks(time::milliseconds(10), 10);
+
+  BOOST_CHECK_EQUAL(sentCommands("/localhost/nfd/rib").size(), 0);
+  auto removed = sentCommands("/localhost/nfd/fib/remove-nexthop");
+  BOOST_REQUIRE_EQUAL(removed.size(), 1);
+  BOOST_CHECK_EQUAL(removed[0].getName(), prefix);
+  BOOST_CHECK_EQUAL(removed[0].getFaceId(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(FailureHandsOverToNewerUpdate)
+{
+  const Name prefix("/localhop/ndvr/dvannc");
+  const Name registerVerb("/localhost/nfd/rib/register");
+  size_t nInstalled = 0;
+  m_queue.Register(prefix, 5, 0, FibUpdateQueue::PRIORITY_HIGH, [&] { nInstalled++; });
+  advanceClocks(time::milliseconds(1), 5);
+  /* registered again while the first command is in flight, which fails */
+  m_queue.Register(prefix, 5, 0, FibUpdateQueue::PRIORITY_HIGH, [&] { nInstalled++; });
+  auto sent = sentCommandInterests(registerVerb);
+  BOOST_REQUIRE_EQUAL(sent.size(), 1);
+  reply(sent[0], 403);
+  advanceClocks(time::milliseconds(1), 5);
+
+  /* the newer update is sent, and both wait for it */
+  sent = sentCommandInterests(registerVerb);
+  BOOST_REQUIRE_EQUAL(sent.size(), 2);
+  reply(sent[1], 200);
+  advanceClocks(time::milliseconds(1), 5);
+  BOOST_CHECK_EQUAL(nInstalled, 2);
+
+  /* and the failed command is not retried on its own */
+  advanceClocks(time::seconds(1), 40);
+  BOOST_CHECK_EQUAL(sentCommandInterests(registerVerb).size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(StateFileRecordsNextHops)
+{
+  const Name prefix("/ndn/site-1");
+  const std::string stateFile = "fib-update-queue-test.fib";
+  std::remove(stateFile.c_str());
+  m_queue.SetDirectFib(true);
+  m_queue.SetStateFile(stateFile);
+  m_queue.Register(prefix, 7, 3, FibUpdateQueue::PRIORITY_HIGH);
+  advanceClocks(time::milliseconds(1), 5);
+  auto sent = sentCommandInterests("/localhost/nfd/fib/add-nexthop");
+  BOOST_REQUIRE_EQUAL(sent.size(), 1);
+  reply(sent[0], 200);
+  advanceClocks(time::milliseconds(100), 20);
+
+  /* what a crashed run leaves for the next one to sweep */
+  std::ifstream input(stateFile);
+  std::string line;
+  BOOST_REQUIRE(std::getline(input, line));
+  BOOST_CHECK_EQUAL(line, "7 /ndn/site-1");
+  BOOST_CHECK(!std::getline(input, line));
+  std::remove(stateFile.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,50 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ndvr-hello.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace ndn {
+namespace ndvr {
+namespace tests {
+
+BOOST_AUTO_TEST_SUITE(TestHelloParams)
+
+BOOST_AUTO_TEST_CASE(TwoNeighbors)
+{
+  const uint8_t digest[20] = {1, 2, 3};
+  std::vector<Name> neighbors = {Name("/ndn/%C1.Router/Router1"), Name("/ndn/%C1.Router/Router2")};
+  Block wire = HelloParams::Encode(7, digest, sizeof(digest), 42, neighbors, "00:11:22:33:44:55",
+                                   HelloParams::FLAG_MERKLE, time::milliseconds(5000));
+
+  HelloParams hello;
+  BOOST_REQUIRE(hello.Decode(wire.value(), wire.value_size()));
+  BOOST_CHECK_EQUAL(hello.GetNumPrefixes(), 7);
+  BOOST_CHECK_EQUAL(hello.GetVersion(), 42);
+  BOOST_CHECK_EQUAL(hello.GetFlags(), HelloParams::FLAG_MERKLE);
+  BOOST_CHECK(hello.GetMaxSilence() == time::milliseconds(5000));
+  BOOST_CHECK(hello.IsDigest(digest, sizeof(digest)));
+  BOOST_CHECK_EQUAL(hello.GetMacAddress(), "00:11:22:33:44:55");
+
+  /* each router of the token sees itself in it */
+  BOOST_CHECK(hello.HasNeighbor(Name("/ndn/%C1.Router/Router1")));
+  BOOST_CHECK(hello.HasNeighbor(Name("/ndn/%C1.Router/Router2")));
+  BOOST_CHECK(!hello.HasNeighbor(Name("/ndn/%C1.Router/Router3")));
+  BOOST_CHECK(!hello.HasNeighbor(Name("/ndn/%C1.Router")));
+}
+
+BOOST_AUTO_TEST_CASE(NoNeighbors)
+{
+  Block wire = HelloParams::Encode(0, nullptr, 0, 1, {}, "");
+
+  HelloParams hello;
+  BOOST_REQUIRE(hello.Decode(wire.value(), wire.value_size()));
+  BOOST_CHECK(!hello.HasDigest());
+  BOOST_CHECK(!hello.HasNeighbor(Name("/ndn/%C1.Router/Router1")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace ndvr
+} // namespace ndn
@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "trickle-timer.hpp"
+
+#include "unit-test-time-fixture.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+namespace ndn {
+namespace ndvr {
+namespace tests {
+
+class TrickleTimerFixture : public UnitTestTimeFixture
+{
+public:
+  TrickleTimerFixture()
+    : m_scheduler(m_io)
+    , m_trickle(m_scheduler, [this] { m_nFired++; }, time::seconds(1), time::seconds(2))
+  {
+  }
+
+protected:
+  Scheduler m_scheduler;
+  TrickleTimer m_trickle;
+  size_t m_nFired = 0;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TestTrickleTimer, TrickleTimerFixture)
+
+BOOST_AUTO_TEST_CASE(SuppressedOnce)
+{
+  m_trickle.Start();
+  m_trickle.HearConsistent();
+  advanceClocks(time::milliseconds(10), 100);
+  BOOST_CHECK_EQUAL(m_nFired, 0);
+
+  /* never two suppressed intervals in a row */
+  m_trickle.HearConsistent();
+  advanceClocks(time::milliseconds(10), 200);
+  BOOST_CHECK_EQUAL(m_nFired, 1);
+  BOOST_CHECK(m_trickle.GetMaxSilence() == time::milliseconds(5000));
+}
+
+BOOST_AUTO_TEST_CASE(ResetAtImin)
+{
+  m_trickle.Start();
+  m_trickle.HearConsistent();
+  /* the interval is already Imin, the pending transmission is no longer
+   * suppressed */
+  m_trickle.Reset();
+  advanceClocks(time::milliseconds(10), 100);
+  BOOST_CHECK_EQUAL(m_nFired, 1);
+}
+
+BOOST_AUTO_TEST_CASE(ResetBackToImin)
+{
+  m_trickle.Start();
+  advanceClocks(time::milliseconds(10), 100);
+  BOOST_CHECK_EQUAL(m_nFired, 1);
+  BOOST_CHECK(m_trickle.GetInterval() == time::seconds(2));
+
+  m_trickle.Reset();
+  BOOST_CHECK(m_trickle.GetInterval() == time::seconds(1));
+  advanceClocks(time::milliseconds(10), 100);
+  BOOST_CHECK_EQUAL(m_nFired, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace tests
+} // namespace ndvr
+} // namespace ndn
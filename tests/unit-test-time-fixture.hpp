@@ -0,0 +1,52 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_TESTS_UNIT_TEST_TIME_FIXTURE_HPP
+#define NDVR_TESTS_UNIT_TEST_TIME_FIXTURE_HPP
+
+#include <boost/asio/io_service.hpp>
+
+#include <ndn-cxx/util/time-unit-test-clock.hpp>
+
+namespace ndn {
+namespace ndvr {
+namespace tests {
+
+/* mock clocks driving the io_service, as in the ndn-cxx unit tests */
+class UnitTestTimeFixture
+{
+public:
+  UnitTestTimeFixture()
+    : m_steadyClock(make_shared<time::UnitTestSteadyClock>())
+    , m_systemClock(make_shared<time::UnitTestSystemClock>())
+  {
+    time::setCustomClocks(m_steadyClock, m_systemClock);
+  }
+
+  ~UnitTestTimeFixture()
+  {
+    time::setCustomClocks(nullptr, nullptr);
+  }
+
+  void
+  advanceClocks(time::nanoseconds tick, size_t nTicks = 1)
+  {
+    for (size_t i = 0; i < nTicks; ++i) {
+      m_steadyClock->advance(tick);
+      m_systemClock->advance(tick);
+      if (m_io.stopped())
+        m_io.reset();
+      m_io.poll();
+    }
+  }
+
+protected:
+  shared_ptr<time::UnitTestSteadyClock> m_steadyClock;
+  shared_ptr<time::UnitTestSystemClock> m_systemClock;
+  boost::asio::io_service m_io;
+};
+
+} // namespace tests
+} // namespace ndvr
+} // namespace ndn
+
+#endif // NDVR_TESTS_UNIT_TEST_TIME_FIXTURE_HPP
@@ -0,0 +1,69 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef NDVR_TOOLS_ALLOC_COUNTER_HPP
+#define NDVR_TOOLS_ALLOC_COUNTER_HPP
+
+/*
+ * Heap accounting for the benchmarks: replaces the global operator
+ * new/delete, so it must be included by exactly one translation unit of
+ * the program. Sizes are the malloc_usable_size of the blocks, i.e., what
+ * the allocator actually hands out.
+ */
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace ndn {
+namespace ndvr {
+namespace bench {
+
+struct AllocCounter {
+  size_t inUse = 0;      /* bytes currently allocated */
+  size_t peak = 0;       /* highest inUse since the last reset() */
+  size_t allocations = 0;
+  size_t allocated = 0;  /* bytes, cumulative */
+
+  static AllocCounter& instance() {
+    static AllocCounter counter;
+    return counter;
+  }
+
+  void reset() {
+    peak = inUse;
+    allocations = 0;
+    allocated = 0;
+  }
+};
+
+} // namespace bench
+} // namespace ndvr
+} // namespace ndn
+
+void* operator new(size_t size) {
+  void* p = std::malloc(size ? size : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  auto& counter = ndn::ndvr::bench::AllocCounter::instance();
+  size_t usable = malloc_usable_size(p);
+  counter.inUse += usable;
+  counter.peak = std::max(counter.peak, counter.inUse);
+  counter.allocations++;
+  counter.allocated += usable;
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  if (p == nullptr)
+    return;
+  ndn::ndvr::bench::AllocCounter::instance().inUse -= malloc_usable_size(p);
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+#endif // NDVR_TOOLS_ALLOC_COUNTER_HPP
@@ -0,0 +1,175 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+ * Cost of encoding and reading a DvInfo.
+ *
+ * Reading: the streaming DvInfoCodec::Read that processDvInfoFromNeighbor
+ * uses, on the protobuf and on the compact encoding, versus the original
+ * path that parsed the whole message and materialized it into a
+ * RoutingTable (a std::map of RoutingEntry) before walking it by value, and
+ * versus expanding the compact encoding back to protobuf before reading it.
+ *
+ * Usage: bench-dvinfo [nEntries ...]   (default: 1000 10000 100000)
+ *
+ * For each DvInfo it reports the size and encoding time of both encodings,
+ * then for each way of reading it the heap allocations and bytes allocated,
+ * the peak heap on top of what was in use before, and the time per entry.
+ * Applying the entries to the local routing table is the same on all paths
+ * and is left out.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "dvinfo-codec.hpp"
+#include "routing-table.hpp"
+#include "alloc-counter.hpp"
+
+using namespace ndn::ndvr;
+using ndn::ndvr::bench::AllocCounter;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/* a full DvInfo shaped like the ones ndvr sends: router prefixes plus a
+ * few application prefixes per site, with path vectors of 1 to 6 routers */
+proto::DvInfo makeDvInfo(size_t n) {
+  proto::DvInfo dvinfo;
+  size_t sites = std::max<size_t>(1, n / 20);
+  for (size_t i = 0; i < n; ++i) {
+    std::string site = std::to_string(i % sites);
+    auto* entry = dvinfo.add_entry();
+    if (i < sites)
+      entry->set_prefix("/ndn/%C1.Router/router-" + site);
+    else
+      entry->set_prefix("/ndn/site-" + site + "/app-" + std::to_string(i / sites % 4) + "/item-" + std::to_string(i));
+    entry->set_seq(1 + i % 5);
+    entry->set_originator("/ndn/%C1.Router/router-" + site);
+    auto* path = entry->mutable_next_hops();
+    for (size_t hop = 0; hop <= i % 6; ++hop) {
+      std::string router = "/ndn/%C1.Router/router-" + std::to_string((i + hop * 7) % sites);
+      path->add_router_id(router);
+      path->set_signature(path->signature() | RouterIdTable::bloomMask(router));
+    }
+  }
+  dvinfo.set_version(42);
+  return dvinfo;
+}
+
+struct Result {
+  size_t allocations;
+  size_t allocated;
+  size_t peak;
+  double nsPerEntry;
+};
+
+template<typename Reader>
+Result measure(size_t n, Reader read) {
+  auto& heap = AllocCounter::instance();
+  /* the first run warms up the router id table and the allocator */
+  read();
+  size_t before = heap.inUse;
+  heap.reset();
+  auto start = Clock::now();
+  size_t checksum = read();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  if (checksum == 0)
+    std::printf("warning: nothing was read\n");
+  return Result{heap.allocations, heap.allocated, heap.peak - before, double(ns) / n};
+}
+
+void print(const char* label, size_t n, const Result& r) {
+  std::printf("%8zu entries  %-12s %9zu allocs (%5.2f/entry) %11zu bytes allocated  peak +%10zu bytes  %7.1f ns/entry\n",
+              n, label, r.allocations, double(r.allocations) / n, r.allocated, r.peak, r.nsPerEntry);
+}
+
+/* what processDvInfoFromNeighbor does with the entries, on either encoding */
+size_t stream(const uint8_t* buf, size_t size) {
+  size_t checksum = 0;
+  uint32_t version;
+  bool isDelta;
+  bool ok = DvInfoCodec::Read(buf, size,
+      [&] (const proto::DvInfo_Entry& entry) {
+        checksum += entry.seq() + entry.next_hops().router_id_size();
+      },
+      [] (const std::string&) {},
+      version, isDelta);
+  return ok ? checksum : 0;
+}
+
+double encodeNs(size_t n, const std::function<void(std::string&)>& encode) {
+  std::string out;
+  encode(out);
+  out.clear();
+  auto start = Clock::now();
+  encode(out);
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()) / n;
+}
+
+void run(size_t n) {
+  proto::DvInfo dvinfo = makeDvInfo(n);
+  std::string wire, compact;
+  dvinfo.SerializeToString(&wire);
+  DvInfoCodec::Compress(dvinfo, compact);
+  const uint8_t* buf = reinterpret_cast<const uint8_t*>(wire.data());
+  const uint8_t* compactBuf = reinterpret_cast<const uint8_t*>(compact.data());
+  double protobufEncode = encodeNs(n, [&] (std::string& out) { dvinfo.SerializeToString(&out); });
+  double compactEncode = encodeNs(n, [&] (std::string& out) { DvInfoCodec::Compress(dvinfo, out); });
+
+  Result materialized = measure(n, [&] {
+    proto::DvInfo dvinfo;
+    if (!dvinfo.ParseFromArray(buf, wire.size()))
+      return size_t(0);
+    std::map<std::string, RoutingEntry> table;
+    for (const auto& entry : dvinfo.entry()) {
+      NextHop path;
+      for (const auto& router : entry.next_hops().router_id())
+        path.AddRouterId(router);
+      table.emplace(entry.prefix(), RoutingEntry(entry.prefix(), entry.seq(), entry.originator(), std::move(path)));
+    }
+    size_t checksum = 0;
+    for (auto entry : table)
+      checksum += entry.second.GetSeqNum() + entry.second.GetNextHops2().GetRouterIds().size();
+    return checksum;
+  });
+
+  Result streamed = measure(n, [&] { return stream(buf, wire.size()); });
+
+  /* compact DvInfo expanded back to protobuf, then streamed */
+  Result expanded = measure(n, [&] {
+    proto::DvInfo decoded;
+    std::string reencoded;
+    if (!DvInfoCodec::Decompress(compactBuf, compact.size(), decoded) || !decoded.SerializeToString(&reencoded))
+      return size_t(0);
+    return stream(reinterpret_cast<const uint8_t*>(reencoded.data()), reencoded.size());
+  });
+
+  Result compactStreamed = measure(n, [&] { return stream(compactBuf, compact.size()); });
+
+  std::printf("%8zu entries  protobuf %zu bytes (encode %.1f ns/entry)  compact %zu bytes (%.2f, encode %.1f ns/entry)\n",
+              n, wire.size(), protobufEncode, compact.size(), double(compact.size()) / wire.size(), compactEncode);
+  print("materialized", n, materialized);
+  print("streamed", n, streamed);
+  print("c-expanded", n, expanded);
+  print("c-streamed", n, compactStreamed);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::vector<size_t> sizes;
+  for (int i = 1; i < argc; ++i)
+    sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+  if (sizes.empty())
+    sizes = {1000, 10000, 100000};
+  for (size_t n : sizes)
+    run(n);
+  return 0;
+}